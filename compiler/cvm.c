@@ -3,6 +3,11 @@
 #include<sys/types.h>
 #include<stdint.h>
 #include<inttypes.h>
+#include<string.h>
+#include<time.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+  #include<x86intrin.h>
+#endif
 
 //============================================================
 //=================== OPCODES ================================
@@ -250,6 +255,10 @@
 #define TEST_AND_CLEAR_BIT_OPCODE 249
 #define STORE_WITH_BARRIER_OPCODE 250
 #define STORE_WITH_BARRIER_OPCODE_VAR_OFFSET 251
+#define ADD_IMM_OPCODE_INT 252
+#define ADD_IMM_OPCODE_LONG 253
+#define SUB_IMM_OPCODE_INT 254
+#define SUB_IMM_OPCODE_LONG 255
 
 char* opcode_names[256];
 void init_opcode_names () {
@@ -495,8 +504,41 @@ void init_opcode_names () {
   opcode_names[TEST_AND_CLEAR_BIT_OPCODE] = "TEST_AND_CLEAR_BIT_OPCODE";
   opcode_names[STORE_WITH_BARRIER_OPCODE] = "STORE_WITH_BARRIER_OPCODE";
   opcode_names[STORE_WITH_BARRIER_OPCODE_VAR_OFFSET] = "STORE_WITH_BARRIER_OPCODE_VAR_OFFSET";
+  opcode_names[ADD_IMM_OPCODE_INT] = "ADD_IMM_OPCODE_INT";
+  opcode_names[ADD_IMM_OPCODE_LONG] = "ADD_IMM_OPCODE_LONG";
+  opcode_names[SUB_IMM_OPCODE_INT] = "SUB_IMM_OPCODE_INT";
+  opcode_names[SUB_IMM_OPCODE_LONG] = "SUB_IMM_OPCODE_LONG";
 }
 
+//============================================================
+//===================== DISPATCH =============================
+//============================================================
+
+//By default, vmloop uses threaded dispatch when compiled with GCC or
+//Clang: every opcode handler ends by jumping directly to the handler
+//of the next opcode through a table of label addresses. This gives
+//every handler its own indirect branch, which the CPU predicts much
+//better than the single shared branch of a switch statement.
+//Compile with -D CVM_SWITCH_DISPATCH to use the portable switch loop.
+#if defined(__GNUC__) && !defined(CVM_SWITCH_DISPATCH)
+  #define CVM_THREADED_DISPATCH
+#endif
+
+#ifdef CVM_THREADED_DISPATCH
+  #define OPCODE_CASE(op) \
+    case op : op##_HANDLER :
+  #define NEXT() \
+    { pc0 = pc; \
+      W1 = PC_INT(); \
+      opcode = W1 & 0xFF; \
+      goto *dispatch[opcode]; }
+#else
+  #define OPCODE_CASE(op) \
+    case op :
+  #define NEXT() \
+    continue
+#endif
+
 //============================================================
 //===================== READ MACROS ==========================
 //============================================================
@@ -557,11 +599,11 @@ void init_opcode_names () {
 #define F_JUMP(condition) \
   if(condition){ \
     pc = pc0 + (n1 * 4); \
-    continue; \
+    NEXT(); \
   } \
   else{ \
     pc = pc0 + (n2 * 4); \
-    continue; \
+    NEXT(); \
   }
 
 #define DECODE_TGTS() \
@@ -610,6 +652,28 @@ void init_opcode_names () {
   stack_pointer = stk->stack_pointer; \
   stack_limit = (char*)(stk->frames) + stk->size;
 
+//Functions are encoded lazily: code_offsets holds UNENCODED_FUNCTION
+//until the function is first called, at which point it is encoded by
+//call_encode_function. Encoding may move the instruction buffer and
+//add dispatch tables, so the cached tables and the pc are refreshed.
+//It also advances the code_epoch, which invalidates the dispatch cache.
+#define UNENCODED_FUNCTION ((uint64_t)-2)
+
+#define FUNCTION_OFFSET(fid) \
+  ({uint64_t _fid = (fid); \
+    uint64_t _fpos = code_offsets[_fid]; \
+    if(_fpos == UNENCODED_FUNCTION){ \
+      uint64_t _pc = pc - instructions; \
+      SAVE_STATE(); \
+      _fpos = call_encode_function(vms, _fid); \
+      RESTORE_STATE(); \
+      instructions = vms->instructions; \
+      code_offsets = vms->code_offsets; \
+      pc = instructions + _pc; \
+      if(vm_profiling > 0) profile_function_encoded(vms, _fid, _fpos); \
+    } \
+    _fpos;})
+
 #define INT_TAG_BITS 0
 #define REF_TAG_BITS 1
 #define MARKER_TAG_BITS 2
@@ -692,6 +756,8 @@ typedef struct{
   //Interpreted Mode Tables
   char* instructions;          //(Permanent State)
   void** trie_table;           //(Permanent State)
+  uint64_t num_functions;      //(Permanent State)
+  uint64_t code_epoch;         //(Permanent State)
 } VMState;
 
 typedef struct{
@@ -779,6 +845,7 @@ static inline uint64_t test_and_clear_bit (uint64_t bit_index, uint64_t* bitset_
 //============================================================
 
 int call_garbage_collector (VMState* vms, uint64_t total_size);
+uint64_t call_encode_function (VMState* vms, uint64_t fid);
 void call_print_stack_trace (VMState* vms, uint64_t stack);
 void* call_collect_stack_trace (VMState* vms, uint64_t stack);
 void c_trampoline (void* fptr, void* argbuffer, void* retbuffer);
@@ -788,6 +855,7 @@ uint64_t lowest_zero_bit_count (uint64_t x);
 //=================== Forward Declarations ===================
 //============================================================
 int read_dispatch_table (VMState* vms, int format);
+int cached_read_dispatch_table (VMState* vms, char* site, int format);
 
 //============================================================
 //==================== Write Barrier =========================
@@ -812,6 +880,295 @@ uint64_t ptr_to_ref (void* p){
   return (uint64_t)p + REF_TAG_BITS;
 }
 
+//============================================================
+//===================== PROFILER =============================
+//============================================================
+
+//When the STANZA_VM_PROFILE environment variable is set, vmloop
+//records the number of executions and the elapsed cycles of every
+//opcode and every function, and prints a report when the process
+//exits. The report is written to the file named by the variable, or
+//to stderr if the variable is empty or "1".
+//
+//The cycles of an instruction are the cycles between its dispatch and
+//the dispatch of the next instruction, so they include the dispatch
+//overhead itself. The function containing an instruction is found by
+//searching the sorted code offsets, which only happens when control
+//leaves the current function. Entering a function at its first
+//instruction is counted as a call.
+//
+//The sorted code offsets are rebuilt only when the code_epoch of the
+//VMState changes, i.e. when code is loaded. A function that is encoded
+//lazily is inserted into them directly.
+//
+//When profiling, the loader registers the name of each function with
+//vm_profile_function_name, so that the report can name them.
+
+typedef struct{
+  uint64_t offset;
+  int64_t fid;
+} FunctionRange;
+
+typedef struct{
+  //Opcode statistics
+  uint64_t opcode_counts[256];
+  uint64_t opcode_cycles[256];
+  //Function statistics, indexed by function id
+  uint64_t num_functions;
+  uint64_t* function_counts;
+  uint64_t* function_cycles;
+  uint64_t* function_calls;
+  //Function ranges sorted by offset, for mapping a pc to a function id,
+  //and the code_epoch they were computed for
+  FunctionRange* ranges;
+  uint64_t num_ranges;
+  uint64_t code_epoch;
+  //The function containing the previous instruction
+  uint64_t fn_start;
+  uint64_t fn_end;
+  int64_t fn_id;
+  //The previous instruction
+  int last_opcode;
+  int64_t last_fid;
+  uint64_t last_time;
+  //Destination of the report
+  char* output;
+} VMProfile;
+
+//-1 : not yet initialized, 0 : disabled, 1 : enabled
+int vm_profiling = -1;
+VMProfile vm_profile;
+
+//Function names, indexed by function id. Kept outside of vm_profile
+//because the loader registers them before vmloop first runs.
+char** vm_profile_names = NULL;
+uint64_t vm_profile_num_names = 0;
+
+void vm_profile_function_name (int64_t fid, char* name){
+  if((uint64_t)fid >= vm_profile_num_names){
+    uint64_t n = 2 * vm_profile_num_names;
+    if(n <= (uint64_t)fid) n = fid + 1;
+    vm_profile_names = (char**)realloc(vm_profile_names, n * sizeof(char*));
+    memset(vm_profile_names + vm_profile_num_names, 0, (n - vm_profile_num_names) * sizeof(char*));
+    vm_profile_num_names = n;
+  }
+  free(vm_profile_names[fid]);
+  vm_profile_names[fid] = strdup(name);
+}
+
+static inline uint64_t profile_clock () {
+#if defined(__x86_64__) && defined(__GNUC__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static int compare_function_ranges (const void* a, const void* b) {
+  uint64_t x = ((const FunctionRange*)a)->offset;
+  uint64_t y = ((const FunctionRange*)b)->offset;
+  return (x > y) - (x < y);
+}
+
+static int compare_by_cycles (const void* a, const void* b, const uint64_t* cycles) {
+  uint64_t x = cycles[*(const int64_t*)a];
+  uint64_t y = cycles[*(const int64_t*)b];
+  return (x < y) - (x > y);
+}
+
+static int compare_opcodes_by_cycles (const void* a, const void* b) {
+  return compare_by_cycles(a, b, vm_profile.opcode_cycles);
+}
+
+static int compare_functions_by_cycles (const void* a, const void* b) {
+  return compare_by_cycles(a, b, vm_profile.function_cycles);
+}
+
+void print_vm_profile (void) {
+  VMProfile* prof = &vm_profile;
+  FILE* out = stderr;
+  if(prof->output[0] != 0 && strcmp(prof->output, "1") != 0){
+    out = fopen(prof->output, "w");
+    if(out == NULL){
+      fprintf(stderr, "Could not open VM profile output file: %s\n", prof->output);
+      return;
+    }
+  }
+
+  //Compute totals
+  uint64_t total_count = 0;
+  uint64_t total_cycles = 0;
+  for(int i=0; i<256; i++){
+    total_count += prof->opcode_counts[i];
+    total_cycles += prof->opcode_cycles[i];
+  }
+  double cycles_denom = total_cycles == 0 ? 1.0 : (double)total_cycles;
+
+  //Opcodes sorted by cycles
+  int64_t opcodes[256];
+  int64_t num_opcodes = 0;
+  for(int i=0; i<256; i++)
+    if(prof->opcode_counts[i] > 0) opcodes[num_opcodes++] = i;
+  qsort(opcodes, num_opcodes, sizeof(int64_t), compare_opcodes_by_cycles);
+  fprintf(out, "===== VM Opcode Profile =====\n");
+  fprintf(out, "Instructions executed: %" PRIu64 "\n", total_count);
+  fprintf(out, "Cycles: %" PRIu64 "\n", total_cycles);
+  fprintf(out, "%-40s %16s %16s %7s\n", "Opcode", "Count", "Cycles", "%");
+  for(int64_t i=0; i<num_opcodes; i++){
+    int64_t op = opcodes[i];
+    fprintf(out, "%-40s %16" PRIu64 " %16" PRIu64 " %6.2f%%\n",
+            opcode_names[op], prof->opcode_counts[op], prof->opcode_cycles[op],
+            100.0 * (double)prof->opcode_cycles[op] / cycles_denom);
+  }
+
+  //Functions sorted by cycles
+  int64_t* fids = (int64_t*)malloc((prof->num_functions + 1) * sizeof(int64_t));
+  int64_t num_fids = 0;
+  for(uint64_t i=0; i<prof->num_functions; i++)
+    if(prof->function_counts[i] > 0) fids[num_fids++] = i;
+  qsort(fids, num_fids, sizeof(int64_t), compare_functions_by_cycles);
+  fprintf(out, "===== VM Function Profile =====\n");
+  fprintf(out, "%-8s %-40s %16s %16s %16s %7s\n", "Id", "Function", "Calls", "Instructions", "Cycles", "%");
+  for(int64_t i=0; i<num_fids; i++){
+    int64_t fid = fids[i];
+    char* name = (uint64_t)fid < vm_profile_num_names ? vm_profile_names[fid] : NULL;
+    fprintf(out, "%-8" PRId64 " %-40s %16" PRIu64 " %16" PRIu64 " %16" PRIu64 " %6.2f%%\n",
+            fid, name == NULL ? "?" : name,
+            prof->function_calls[fid], prof->function_counts[fid], prof->function_cycles[fid],
+            100.0 * (double)prof->function_cycles[fid] / cycles_denom);
+  }
+  free(fids);
+
+  if(out != stderr) fclose(out);
+}
+
+void init_vm_profile (void) {
+  char* output = getenv("STANZA_VM_PROFILE");
+  if(output == NULL){
+    vm_profiling = 0;
+    return;
+  }
+  memset(&vm_profile, 0, sizeof(VMProfile));
+  vm_profile.output = output;
+  vm_profile.last_opcode = -1;
+  vm_profile.fn_id = -1;
+  init_opcode_names();
+  atexit(print_vm_profile);
+  vm_profiling = 1;
+}
+
+//Grow the function statistics and rebuild the function ranges after
+//new code has been loaded.
+static void update_function_ranges (VMProfile* prof, VMState* vms) {
+  uint64_t n = vms->num_functions;
+  if(n > prof->num_functions){
+    uint64_t** tables[3] = {&prof->function_counts, &prof->function_cycles, &prof->function_calls};
+    for(int i=0; i<3; i++){
+      *tables[i] = (uint64_t*)realloc(*tables[i], n * sizeof(uint64_t));
+      memset(*tables[i] + prof->num_functions, 0, (n - prof->num_functions) * sizeof(uint64_t));
+    }
+    prof->num_functions = n;
+  }
+  prof->ranges = (FunctionRange*)realloc(prof->ranges, (n + 1) * sizeof(FunctionRange));
+  prof->num_ranges = 0;
+  for(uint64_t fid=0; fid<n; fid++){
+    uint64_t offset = vms->code_offsets[fid];
+    if(offset != (uint64_t)-1 && offset != UNENCODED_FUNCTION){
+      prof->ranges[prof->num_ranges].offset = offset;
+      prof->ranges[prof->num_ranges].fid = fid;
+      prof->num_ranges++;
+    }
+  }
+  qsort(prof->ranges, prof->num_ranges, sizeof(FunctionRange), compare_function_ranges);
+  prof->code_epoch = vms->code_epoch;
+  prof->fn_start = 1;
+  prof->fn_end = 0;
+  prof->fn_id = -1;
+}
+
+//Called after the function fid has been encoded lazily at the given
+//offset. Encoding advances the code_epoch by one, so if the ranges were
+//up to date before, inserting the new range brings them up to date
+//again. Otherwise they are rebuilt by the next profile_instruction.
+static void profile_function_encoded (VMState* vms, uint64_t fid, uint64_t offset) {
+  VMProfile* prof = &vm_profile;
+  if(prof->code_epoch + 1 != vms->code_epoch) return;
+  uint64_t lo = 0;
+  uint64_t hi = prof->num_ranges;
+  while(lo < hi){
+    uint64_t mid = lo + (hi - lo) / 2;
+    if(prof->ranges[mid].offset < offset) lo = mid + 1;
+    else hi = mid;
+  }
+  memmove(prof->ranges + lo + 1, prof->ranges + lo, (prof->num_ranges - lo) * sizeof(FunctionRange));
+  prof->ranges[lo].offset = offset;
+  prof->ranges[lo].fid = fid;
+  prof->num_ranges++;
+  prof->code_epoch = vms->code_epoch;
+  prof->fn_start = 1;
+  prof->fn_end = 0;
+  prof->fn_id = -1;
+}
+
+//Find the function containing the given offset, and cache its range.
+static void find_function (VMProfile* prof, uint64_t offset) {
+  int64_t lo = 0;
+  int64_t hi = (int64_t)prof->num_ranges - 1;
+  int64_t found = -1;
+  while(lo <= hi){
+    int64_t mid = lo + (hi - lo) / 2;
+    if(prof->ranges[mid].offset <= offset){
+      found = mid;
+      lo = mid + 1;
+    }else{
+      hi = mid - 1;
+    }
+  }
+  if(found < 0){
+    prof->fn_start = 0;
+    prof->fn_end = prof->num_ranges > 0 ? prof->ranges[0].offset : UINT64_MAX;
+    prof->fn_id = -1;
+  }else{
+    prof->fn_start = prof->ranges[found].offset;
+    prof->fn_end = found + 1 < (int64_t)prof->num_ranges ? prof->ranges[found + 1].offset : UINT64_MAX;
+    prof->fn_id = prof->ranges[found].fid;
+  }
+}
+
+//Called before executing each instruction when profiling is enabled.
+static void profile_instruction (VMState* vms, char* pc0, int opcode) {
+  uint64_t now = profile_clock();
+  VMProfile* prof = &vm_profile;
+
+  //Attribute elapsed cycles to the previous instruction.
+  if(prof->last_opcode >= 0){
+    uint64_t elapsed = now - prof->last_time;
+    prof->opcode_cycles[prof->last_opcode] += elapsed;
+    if(prof->last_fid >= 0)
+      prof->function_cycles[prof->last_fid] += elapsed;
+  }
+
+  //Find the function containing this instruction.
+  if(vms->code_epoch != prof->code_epoch)
+    update_function_ranges(prof, vms);
+  uint64_t offset = (uint64_t)(pc0 - vms->instructions);
+  if(offset < prof->fn_start || offset >= prof->fn_end)
+    find_function(prof, offset);
+
+  //Record this instruction.
+  prof->opcode_counts[opcode]++;
+  if(prof->fn_id >= 0){
+    prof->function_counts[prof->fn_id]++;
+    if(offset == prof->fn_start)
+      prof->function_calls[prof->fn_id]++;
+  }
+  prof->last_opcode = opcode;
+  prof->last_fid = prof->fn_id;
+  prof->last_time = profile_clock();
+}
+
 //long iprint_start;
 //long iprint_end;
 //long iprint_step;
@@ -849,13 +1206,283 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
   Stack* stk = untag_stack(current_stack);
   StackFrame* stack_pointer = stk->stack_pointer;
   char* stack_limit = (char*)(stk->frames) + stk->size;
-  char* pc = instructions + code_offsets[starting_fid];
+  char* pc = instructions;
+
+  //Decoded state of the current instruction
+  char* pc0;
+  uint32_t W1;
+  int opcode;
+
+  #ifdef CVM_THREADED_DISPATCH
+  //Table of handler addresses for threaded dispatch.
+  //All unused opcodes jump to the invalid opcode handler.
+  static void* dispatch_table[256] = {
+    [0 ... 255] = &&INVALID_OPCODE_HANDLER,
+    [SET_OPCODE_LOCAL] = &&SET_OPCODE_LOCAL_HANDLER,
+    [SET_OPCODE_UNSIGNED] = &&SET_OPCODE_UNSIGNED_HANDLER,
+    [SET_OPCODE_SIGNED] = &&SET_OPCODE_SIGNED_HANDLER,
+    [SET_OPCODE_CODE] = &&SET_OPCODE_CODE_HANDLER,
+    [SET_OPCODE_GLOBAL] = &&SET_OPCODE_GLOBAL_HANDLER,
+    [SET_OPCODE_DATA] = &&SET_OPCODE_DATA_HANDLER,
+    [SET_OPCODE_CONST] = &&SET_OPCODE_CONST_HANDLER,
+    [SET_OPCODE_WIDE] = &&SET_OPCODE_WIDE_HANDLER,
+    [SET_REG_OPCODE_LOCAL] = &&SET_REG_OPCODE_LOCAL_HANDLER,
+    [SET_REG_OPCODE_UNSIGNED] = &&SET_REG_OPCODE_UNSIGNED_HANDLER,
+    [SET_REG_OPCODE_SIGNED] = &&SET_REG_OPCODE_SIGNED_HANDLER,
+    [SET_REG_OPCODE_CODE] = &&SET_REG_OPCODE_CODE_HANDLER,
+    [SET_REG_OPCODE_GLOBAL] = &&SET_REG_OPCODE_GLOBAL_HANDLER,
+    [SET_REG_OPCODE_DATA] = &&SET_REG_OPCODE_DATA_HANDLER,
+    [SET_REG_OPCODE_CONST] = &&SET_REG_OPCODE_CONST_HANDLER,
+    [SET_REG_OPCODE_WIDE] = &&SET_REG_OPCODE_WIDE_HANDLER,
+    [GET_REG_OPCODE] = &&GET_REG_OPCODE_HANDLER,
+    [CALL_OPCODE_LOCAL] = &&CALL_OPCODE_LOCAL_HANDLER,
+    [CALL_OPCODE_CODE] = &&CALL_OPCODE_CODE_HANDLER,
+    [CALL_CLOSURE_OPCODE] = &&CALL_CLOSURE_OPCODE_HANDLER,
+    [TCALL_OPCODE_LOCAL] = &&TCALL_OPCODE_LOCAL_HANDLER,
+    [TCALL_OPCODE_CODE] = &&TCALL_OPCODE_CODE_HANDLER,
+    [TCALL_CLOSURE_OPCODE] = &&TCALL_CLOSURE_OPCODE_HANDLER,
+    [CALLC_OPCODE_LOCAL] = &&CALLC_OPCODE_LOCAL_HANDLER,
+    [CALLC_OPCODE_WIDE] = &&CALLC_OPCODE_WIDE_HANDLER,
+    [POP_FRAME_OPCODE] = &&POP_FRAME_OPCODE_HANDLER,
+    [LIVE_OPCODE] = &&LIVE_OPCODE_HANDLER,
+    [ENTER_STACK_OPCODE] = &&ENTER_STACK_OPCODE_HANDLER,
+    [YIELD_OPCODE] = &&YIELD_OPCODE_HANDLER,
+    [RETURN_OPCODE] = &&RETURN_OPCODE_HANDLER,
+    [DUMP_OPCODE] = &&DUMP_OPCODE_HANDLER,
+    [INT_ADD_OPCODE] = &&INT_ADD_OPCODE_HANDLER,
+    [INT_SUB_OPCODE] = &&INT_SUB_OPCODE_HANDLER,
+    [INT_MUL_OPCODE] = &&INT_MUL_OPCODE_HANDLER,
+    [INT_DIV_OPCODE] = &&INT_DIV_OPCODE_HANDLER,
+    [INT_MOD_OPCODE] = &&INT_MOD_OPCODE_HANDLER,
+    [INT_AND_OPCODE] = &&INT_AND_OPCODE_HANDLER,
+    [INT_OR_OPCODE] = &&INT_OR_OPCODE_HANDLER,
+    [INT_XOR_OPCODE] = &&INT_XOR_OPCODE_HANDLER,
+    [INT_SHL_OPCODE] = &&INT_SHL_OPCODE_HANDLER,
+    [INT_SHR_OPCODE] = &&INT_SHR_OPCODE_HANDLER,
+    [INT_ASHR_OPCODE] = &&INT_ASHR_OPCODE_HANDLER,
+    [INT_LT_OPCODE] = &&INT_LT_OPCODE_HANDLER,
+    [INT_GT_OPCODE] = &&INT_GT_OPCODE_HANDLER,
+    [INT_LE_OPCODE] = &&INT_LE_OPCODE_HANDLER,
+    [INT_GE_OPCODE] = &&INT_GE_OPCODE_HANDLER,
+    [REF_EQ_OPCODE] = &&REF_EQ_OPCODE_HANDLER,
+    [EQ_OPCODE_REF] = &&EQ_OPCODE_REF_HANDLER,
+    [EQ_OPCODE_BYTE] = &&EQ_OPCODE_BYTE_HANDLER,
+    [EQ_OPCODE_INT] = &&EQ_OPCODE_INT_HANDLER,
+    [EQ_OPCODE_LONG] = &&EQ_OPCODE_LONG_HANDLER,
+    [EQ_OPCODE_FLOAT] = &&EQ_OPCODE_FLOAT_HANDLER,
+    [EQ_OPCODE_DOUBLE] = &&EQ_OPCODE_DOUBLE_HANDLER,
+    [REF_NE_OPCODE] = &&REF_NE_OPCODE_HANDLER,
+    [NE_OPCODE_REF] = &&NE_OPCODE_REF_HANDLER,
+    [NE_OPCODE_BYTE] = &&NE_OPCODE_BYTE_HANDLER,
+    [NE_OPCODE_INT] = &&NE_OPCODE_INT_HANDLER,
+    [NE_OPCODE_LONG] = &&NE_OPCODE_LONG_HANDLER,
+    [NE_OPCODE_FLOAT] = &&NE_OPCODE_FLOAT_HANDLER,
+    [NE_OPCODE_DOUBLE] = &&NE_OPCODE_DOUBLE_HANDLER,
+    [ADD_OPCODE_BYTE] = &&ADD_OPCODE_BYTE_HANDLER,
+    [ADD_OPCODE_INT] = &&ADD_OPCODE_INT_HANDLER,
+    [ADD_OPCODE_LONG] = &&ADD_OPCODE_LONG_HANDLER,
+    [ADD_OPCODE_FLOAT] = &&ADD_OPCODE_FLOAT_HANDLER,
+    [ADD_OPCODE_DOUBLE] = &&ADD_OPCODE_DOUBLE_HANDLER,
+    [SUB_OPCODE_BYTE] = &&SUB_OPCODE_BYTE_HANDLER,
+    [SUB_OPCODE_INT] = &&SUB_OPCODE_INT_HANDLER,
+    [SUB_OPCODE_LONG] = &&SUB_OPCODE_LONG_HANDLER,
+    [SUB_OPCODE_FLOAT] = &&SUB_OPCODE_FLOAT_HANDLER,
+    [SUB_OPCODE_DOUBLE] = &&SUB_OPCODE_DOUBLE_HANDLER,
+    [MUL_OPCODE_BYTE] = &&MUL_OPCODE_BYTE_HANDLER,
+    [MUL_OPCODE_INT] = &&MUL_OPCODE_INT_HANDLER,
+    [MUL_OPCODE_LONG] = &&MUL_OPCODE_LONG_HANDLER,
+    [MUL_OPCODE_FLOAT] = &&MUL_OPCODE_FLOAT_HANDLER,
+    [MUL_OPCODE_DOUBLE] = &&MUL_OPCODE_DOUBLE_HANDLER,
+    [DIV_OPCODE_BYTE] = &&DIV_OPCODE_BYTE_HANDLER,
+    [DIV_OPCODE_INT] = &&DIV_OPCODE_INT_HANDLER,
+    [DIV_OPCODE_LONG] = &&DIV_OPCODE_LONG_HANDLER,
+    [DIV_OPCODE_FLOAT] = &&DIV_OPCODE_FLOAT_HANDLER,
+    [DIV_OPCODE_DOUBLE] = &&DIV_OPCODE_DOUBLE_HANDLER,
+    [MOD_OPCODE_BYTE] = &&MOD_OPCODE_BYTE_HANDLER,
+    [MOD_OPCODE_INT] = &&MOD_OPCODE_INT_HANDLER,
+    [MOD_OPCODE_LONG] = &&MOD_OPCODE_LONG_HANDLER,
+    [AND_OPCODE_BYTE] = &&AND_OPCODE_BYTE_HANDLER,
+    [AND_OPCODE_INT] = &&AND_OPCODE_INT_HANDLER,
+    [AND_OPCODE_LONG] = &&AND_OPCODE_LONG_HANDLER,
+    [OR_OPCODE_BYTE] = &&OR_OPCODE_BYTE_HANDLER,
+    [OR_OPCODE_INT] = &&OR_OPCODE_INT_HANDLER,
+    [OR_OPCODE_LONG] = &&OR_OPCODE_LONG_HANDLER,
+    [XOR_OPCODE_BYTE] = &&XOR_OPCODE_BYTE_HANDLER,
+    [XOR_OPCODE_INT] = &&XOR_OPCODE_INT_HANDLER,
+    [XOR_OPCODE_LONG] = &&XOR_OPCODE_LONG_HANDLER,
+    [SHL_OPCODE_BYTE] = &&SHL_OPCODE_BYTE_HANDLER,
+    [SHL_OPCODE_INT] = &&SHL_OPCODE_INT_HANDLER,
+    [SHL_OPCODE_LONG] = &&SHL_OPCODE_LONG_HANDLER,
+    [SHR_OPCODE_BYTE] = &&SHR_OPCODE_BYTE_HANDLER,
+    [SHR_OPCODE_INT] = &&SHR_OPCODE_INT_HANDLER,
+    [SHR_OPCODE_LONG] = &&SHR_OPCODE_LONG_HANDLER,
+    [ASHR_OPCODE_INT] = &&ASHR_OPCODE_INT_HANDLER,
+    [ASHR_OPCODE_LONG] = &&ASHR_OPCODE_LONG_HANDLER,
+    [LT_OPCODE_INT] = &&LT_OPCODE_INT_HANDLER,
+    [LT_OPCODE_LONG] = &&LT_OPCODE_LONG_HANDLER,
+    [LT_OPCODE_FLOAT] = &&LT_OPCODE_FLOAT_HANDLER,
+    [LT_OPCODE_DOUBLE] = &&LT_OPCODE_DOUBLE_HANDLER,
+    [GT_OPCODE_INT] = &&GT_OPCODE_INT_HANDLER,
+    [GT_OPCODE_LONG] = &&GT_OPCODE_LONG_HANDLER,
+    [GT_OPCODE_FLOAT] = &&GT_OPCODE_FLOAT_HANDLER,
+    [GT_OPCODE_DOUBLE] = &&GT_OPCODE_DOUBLE_HANDLER,
+    [LE_OPCODE_INT] = &&LE_OPCODE_INT_HANDLER,
+    [LE_OPCODE_LONG] = &&LE_OPCODE_LONG_HANDLER,
+    [LE_OPCODE_FLOAT] = &&LE_OPCODE_FLOAT_HANDLER,
+    [LE_OPCODE_DOUBLE] = &&LE_OPCODE_DOUBLE_HANDLER,
+    [GE_OPCODE_INT] = &&GE_OPCODE_INT_HANDLER,
+    [GE_OPCODE_LONG] = &&GE_OPCODE_LONG_HANDLER,
+    [GE_OPCODE_FLOAT] = &&GE_OPCODE_FLOAT_HANDLER,
+    [GE_OPCODE_DOUBLE] = &&GE_OPCODE_DOUBLE_HANDLER,
+    [ULE_OPCODE_BYTE] = &&ULE_OPCODE_BYTE_HANDLER,
+    [ULE_OPCODE_INT] = &&ULE_OPCODE_INT_HANDLER,
+    [ULE_OPCODE_LONG] = &&ULE_OPCODE_LONG_HANDLER,
+    [ULT_OPCODE_BYTE] = &&ULT_OPCODE_BYTE_HANDLER,
+    [ULT_OPCODE_INT] = &&ULT_OPCODE_INT_HANDLER,
+    [ULT_OPCODE_LONG] = &&ULT_OPCODE_LONG_HANDLER,
+    [UGT_OPCODE_BYTE] = &&UGT_OPCODE_BYTE_HANDLER,
+    [UGT_OPCODE_INT] = &&UGT_OPCODE_INT_HANDLER,
+    [UGT_OPCODE_LONG] = &&UGT_OPCODE_LONG_HANDLER,
+    [UGE_OPCODE_BYTE] = &&UGE_OPCODE_BYTE_HANDLER,
+    [UGE_OPCODE_INT] = &&UGE_OPCODE_INT_HANDLER,
+    [UGE_OPCODE_LONG] = &&UGE_OPCODE_LONG_HANDLER,
+    [INT_NOT_OPCODE] = &&INT_NOT_OPCODE_HANDLER,
+    [INT_NEG_OPCODE] = &&INT_NEG_OPCODE_HANDLER,
+    [NOT_OPCODE_BYTE] = &&NOT_OPCODE_BYTE_HANDLER,
+    [NOT_OPCODE_INT] = &&NOT_OPCODE_INT_HANDLER,
+    [NOT_OPCODE_LONG] = &&NOT_OPCODE_LONG_HANDLER,
+    [NEG_OPCODE_INT] = &&NEG_OPCODE_INT_HANDLER,
+    [NEG_OPCODE_LONG] = &&NEG_OPCODE_LONG_HANDLER,
+    [NEG_OPCODE_FLOAT] = &&NEG_OPCODE_FLOAT_HANDLER,
+    [NEG_OPCODE_DOUBLE] = &&NEG_OPCODE_DOUBLE_HANDLER,
+    [DEREF_OPCODE] = &&DEREF_OPCODE_HANDLER,
+    [TYPEOF_OPCODE] = &&TYPEOF_OPCODE_HANDLER,
+    [JUMP_SET_OPCODE] = &&JUMP_SET_OPCODE_HANDLER,
+    [JUMP_TAGBITS_OPCODE] = &&JUMP_TAGBITS_OPCODE_HANDLER,
+    [JUMP_TAGWORD_OPCODE] = &&JUMP_TAGWORD_OPCODE_HANDLER,
+    [GOTO_OPCODE] = &&GOTO_OPCODE_HANDLER,
+    [CONV_OPCODE_BYTE_FLOAT] = &&CONV_OPCODE_BYTE_FLOAT_HANDLER,
+    [CONV_OPCODE_BYTE_DOUBLE] = &&CONV_OPCODE_BYTE_DOUBLE_HANDLER,
+    [CONV_OPCODE_INT_BYTE] = &&CONV_OPCODE_INT_BYTE_HANDLER,
+    [CONV_OPCODE_INT_FLOAT] = &&CONV_OPCODE_INT_FLOAT_HANDLER,
+    [CONV_OPCODE_INT_DOUBLE] = &&CONV_OPCODE_INT_DOUBLE_HANDLER,
+    [CONV_OPCODE_LONG_BYTE] = &&CONV_OPCODE_LONG_BYTE_HANDLER,
+    [CONV_OPCODE_LONG_INT] = &&CONV_OPCODE_LONG_INT_HANDLER,
+    [CONV_OPCODE_LONG_FLOAT] = &&CONV_OPCODE_LONG_FLOAT_HANDLER,
+    [CONV_OPCODE_LONG_DOUBLE] = &&CONV_OPCODE_LONG_DOUBLE_HANDLER,
+    [CONV_OPCODE_FLOAT_BYTE] = &&CONV_OPCODE_FLOAT_BYTE_HANDLER,
+    [CONV_OPCODE_FLOAT_INT] = &&CONV_OPCODE_FLOAT_INT_HANDLER,
+    [CONV_OPCODE_FLOAT_LONG] = &&CONV_OPCODE_FLOAT_LONG_HANDLER,
+    [CONV_OPCODE_FLOAT_DOUBLE] = &&CONV_OPCODE_FLOAT_DOUBLE_HANDLER,
+    [CONV_OPCODE_DOUBLE_BYTE] = &&CONV_OPCODE_DOUBLE_BYTE_HANDLER,
+    [CONV_OPCODE_DOUBLE_INT] = &&CONV_OPCODE_DOUBLE_INT_HANDLER,
+    [CONV_OPCODE_DOUBLE_LONG] = &&CONV_OPCODE_DOUBLE_LONG_HANDLER,
+    [CONV_OPCODE_DOUBLE_FLOAT] = &&CONV_OPCODE_DOUBLE_FLOAT_HANDLER,
+    [DETAG_OPCODE] = &&DETAG_OPCODE_HANDLER,
+    [TAG_OPCODE_BYTE] = &&TAG_OPCODE_BYTE_HANDLER,
+    [TAG_OPCODE_CHAR] = &&TAG_OPCODE_CHAR_HANDLER,
+    [TAG_OPCODE_INT] = &&TAG_OPCODE_INT_HANDLER,
+    [TAG_OPCODE_FLOAT] = &&TAG_OPCODE_FLOAT_HANDLER,
+    [STORE_OPCODE_1] = &&STORE_OPCODE_1_HANDLER,
+    [STORE_OPCODE_4] = &&STORE_OPCODE_4_HANDLER,
+    [STORE_OPCODE_8] = &&STORE_OPCODE_8_HANDLER,
+    [STORE_OPCODE_1_VAR_OFFSET] = &&STORE_OPCODE_1_VAR_OFFSET_HANDLER,
+    [STORE_OPCODE_4_VAR_OFFSET] = &&STORE_OPCODE_4_VAR_OFFSET_HANDLER,
+    [STORE_OPCODE_8_VAR_OFFSET] = &&STORE_OPCODE_8_VAR_OFFSET_HANDLER,
+    [STORE_WITH_BARRIER_OPCODE] = &&STORE_WITH_BARRIER_OPCODE_HANDLER,
+    [STORE_WITH_BARRIER_OPCODE_VAR_OFFSET] = &&STORE_WITH_BARRIER_OPCODE_VAR_OFFSET_HANDLER,
+    [ADD_IMM_OPCODE_INT] = &&ADD_IMM_OPCODE_INT_HANDLER,
+    [ADD_IMM_OPCODE_LONG] = &&ADD_IMM_OPCODE_LONG_HANDLER,
+    [SUB_IMM_OPCODE_INT] = &&SUB_IMM_OPCODE_INT_HANDLER,
+    [SUB_IMM_OPCODE_LONG] = &&SUB_IMM_OPCODE_LONG_HANDLER,
+    [LOAD_OPCODE_1] = &&LOAD_OPCODE_1_HANDLER,
+    [LOAD_OPCODE_4] = &&LOAD_OPCODE_4_HANDLER,
+    [LOAD_OPCODE_8] = &&LOAD_OPCODE_8_HANDLER,
+    [LOAD_OPCODE_1_VAR_OFFSET] = &&LOAD_OPCODE_1_VAR_OFFSET_HANDLER,
+    [LOAD_OPCODE_4_VAR_OFFSET] = &&LOAD_OPCODE_4_VAR_OFFSET_HANDLER,
+    [LOAD_OPCODE_8_VAR_OFFSET] = &&LOAD_OPCODE_8_VAR_OFFSET_HANDLER,
+    [RESERVE_OPCODE_LOCAL] = &&RESERVE_OPCODE_LOCAL_HANDLER,
+    [RESERVE_OPCODE_CONST] = &&RESERVE_OPCODE_CONST_HANDLER,
+    [ALLOC_OPCODE_CONST] = &&ALLOC_OPCODE_CONST_HANDLER,
+    [ALLOC_OPCODE_LOCAL] = &&ALLOC_OPCODE_LOCAL_HANDLER,
+    [GC_OPCODE] = &&GC_OPCODE_HANDLER,
+    [PRINT_STACK_TRACE_OPCODE] = &&PRINT_STACK_TRACE_OPCODE_HANDLER,
+    [COLLECT_STACK_TRACE_OPCODE] = &&COLLECT_STACK_TRACE_OPCODE_HANDLER,
+    [FLUSH_VM_OPCODE] = &&FLUSH_VM_OPCODE_HANDLER,
+    [C_RSP_OPCODE] = &&C_RSP_OPCODE_HANDLER,
+    [JUMP_INT_LT_OPCODE] = &&JUMP_INT_LT_OPCODE_HANDLER,
+    [JUMP_INT_GT_OPCODE] = &&JUMP_INT_GT_OPCODE_HANDLER,
+    [JUMP_INT_LE_OPCODE] = &&JUMP_INT_LE_OPCODE_HANDLER,
+    [JUMP_INT_GE_OPCODE] = &&JUMP_INT_GE_OPCODE_HANDLER,
+    [JUMP_EQ_OPCODE_REF] = &&JUMP_EQ_OPCODE_REF_HANDLER,
+    [JUMP_EQ_OPCODE_BYTE] = &&JUMP_EQ_OPCODE_BYTE_HANDLER,
+    [JUMP_EQ_OPCODE_INT] = &&JUMP_EQ_OPCODE_INT_HANDLER,
+    [JUMP_EQ_OPCODE_LONG] = &&JUMP_EQ_OPCODE_LONG_HANDLER,
+    [JUMP_EQ_OPCODE_FLOAT] = &&JUMP_EQ_OPCODE_FLOAT_HANDLER,
+    [JUMP_EQ_OPCODE_DOUBLE] = &&JUMP_EQ_OPCODE_DOUBLE_HANDLER,
+    [JUMP_NE_OPCODE_REF] = &&JUMP_NE_OPCODE_REF_HANDLER,
+    [JUMP_NE_OPCODE_BYTE] = &&JUMP_NE_OPCODE_BYTE_HANDLER,
+    [JUMP_NE_OPCODE_INT] = &&JUMP_NE_OPCODE_INT_HANDLER,
+    [JUMP_NE_OPCODE_LONG] = &&JUMP_NE_OPCODE_LONG_HANDLER,
+    [JUMP_NE_OPCODE_FLOAT] = &&JUMP_NE_OPCODE_FLOAT_HANDLER,
+    [JUMP_NE_OPCODE_DOUBLE] = &&JUMP_NE_OPCODE_DOUBLE_HANDLER,
+    [JUMP_LT_OPCODE_INT] = &&JUMP_LT_OPCODE_INT_HANDLER,
+    [JUMP_LT_OPCODE_LONG] = &&JUMP_LT_OPCODE_LONG_HANDLER,
+    [JUMP_LT_OPCODE_FLOAT] = &&JUMP_LT_OPCODE_FLOAT_HANDLER,
+    [JUMP_LT_OPCODE_DOUBLE] = &&JUMP_LT_OPCODE_DOUBLE_HANDLER,
+    [JUMP_GT_OPCODE_INT] = &&JUMP_GT_OPCODE_INT_HANDLER,
+    [JUMP_GT_OPCODE_LONG] = &&JUMP_GT_OPCODE_LONG_HANDLER,
+    [JUMP_GT_OPCODE_FLOAT] = &&JUMP_GT_OPCODE_FLOAT_HANDLER,
+    [JUMP_GT_OPCODE_DOUBLE] = &&JUMP_GT_OPCODE_DOUBLE_HANDLER,
+    [JUMP_LE_OPCODE_INT] = &&JUMP_LE_OPCODE_INT_HANDLER,
+    [JUMP_LE_OPCODE_LONG] = &&JUMP_LE_OPCODE_LONG_HANDLER,
+    [JUMP_LE_OPCODE_FLOAT] = &&JUMP_LE_OPCODE_FLOAT_HANDLER,
+    [JUMP_LE_OPCODE_DOUBLE] = &&JUMP_LE_OPCODE_DOUBLE_HANDLER,
+    [JUMP_GE_OPCODE_INT] = &&JUMP_GE_OPCODE_INT_HANDLER,
+    [JUMP_GE_OPCODE_LONG] = &&JUMP_GE_OPCODE_LONG_HANDLER,
+    [JUMP_GE_OPCODE_FLOAT] = &&JUMP_GE_OPCODE_FLOAT_HANDLER,
+    [JUMP_GE_OPCODE_DOUBLE] = &&JUMP_GE_OPCODE_DOUBLE_HANDLER,
+    [JUMP_ULE_OPCODE_BYTE] = &&JUMP_ULE_OPCODE_BYTE_HANDLER,
+    [JUMP_ULE_OPCODE_INT] = &&JUMP_ULE_OPCODE_INT_HANDLER,
+    [JUMP_ULE_OPCODE_LONG] = &&JUMP_ULE_OPCODE_LONG_HANDLER,
+    [JUMP_ULT_OPCODE_BYTE] = &&JUMP_ULT_OPCODE_BYTE_HANDLER,
+    [JUMP_ULT_OPCODE_INT] = &&JUMP_ULT_OPCODE_INT_HANDLER,
+    [JUMP_ULT_OPCODE_LONG] = &&JUMP_ULT_OPCODE_LONG_HANDLER,
+    [JUMP_UGE_OPCODE_BYTE] = &&JUMP_UGE_OPCODE_BYTE_HANDLER,
+    [JUMP_UGE_OPCODE_INT] = &&JUMP_UGE_OPCODE_INT_HANDLER,
+    [JUMP_UGE_OPCODE_LONG] = &&JUMP_UGE_OPCODE_LONG_HANDLER,
+    [JUMP_UGT_OPCODE_BYTE] = &&JUMP_UGT_OPCODE_BYTE_HANDLER,
+    [JUMP_UGT_OPCODE_INT] = &&JUMP_UGT_OPCODE_INT_HANDLER,
+    [JUMP_UGT_OPCODE_LONG] = &&JUMP_UGT_OPCODE_LONG_HANDLER,
+    [DISPATCH_OPCODE] = &&DISPATCH_OPCODE_HANDLER,
+    [DISPATCH_METHOD_OPCODE] = &&DISPATCH_METHOD_OPCODE_HANDLER,
+    [JUMP_REG_OPCODE] = &&JUMP_REG_OPCODE_HANDLER,
+    [FNENTRY_OPCODE] = &&FNENTRY_OPCODE_HANDLER,
+    [LOWEST_ZERO_BIT_COUNT_OPCODE_LONG] = &&LOWEST_ZERO_BIT_COUNT_OPCODE_LONG_HANDLER,
+    [SET_BIT_OPCODE] = &&SET_BIT_OPCODE_HANDLER,
+    [CLEAR_BIT_OPCODE] = &&CLEAR_BIT_OPCODE_HANDLER,
+    [TEST_BIT_OPCODE] = &&TEST_BIT_OPCODE_HANDLER,
+    [TEST_AND_SET_BIT_OPCODE] = &&TEST_AND_SET_BIT_OPCODE_HANDLER,
+    [TEST_AND_CLEAR_BIT_OPCODE] = &&TEST_AND_CLEAR_BIT_OPCODE_HANDLER
+  };
+  //When profiling, every opcode first goes through the profiling handler.
+  static void* profile_dispatch_table[256] = {
+    [0 ... 255] = &&PROFILE_HANDLER
+  };
+  #endif
+
+  //Profiling
+  if(vm_profiling < 0) init_vm_profile();
+  if(vm_profiling){
+    //Do not attribute the time since the last launch.
+    vm_profile.last_opcode = -1;
+  }
+  #ifdef CVM_THREADED_DISPATCH
+  void** dispatch = vm_profiling ? profile_dispatch_table : dispatch_table;
+  #endif
 
-  //Timing
-  //uint64_t* timings = (uint64_t*)malloc(255 * sizeof(uint64_t));
-  //for(int i=0; i<255; i++) timings[i] = 0;
-  //int last_opcode = -1;
-  //uint64_t last_time;
+  //Start at the first instruction of the starting function.
+  pc = instructions + FUNCTION_OFFSET(starting_fid);
 
   //Debug
   //init_iprint();
@@ -867,159 +1494,156 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
 
     //Save pre-decode PC because jump offsets are relative to
     //pre-decode PC.
-    char* pc0 = pc;
-    uint32_t W1 = PC_INT();
-    int opcode = W1 & 0xFF;
+    pc0 = pc;
+    W1 = PC_INT();
+    opcode = W1 & 0xFF;
 
-    //uint64_t curtime = current_time_ms();
-    //if(last_opcode >= 0)
-    //  timings[last_opcode] += curtime - last_time;
-    //last_opcode = opcode;
-    //last_time = curtime;
+    if(vm_profiling)
+      profile_instruction(vms, pc0, opcode);
 
     switch(opcode){
-    case SET_OPCODE_LOCAL : {
+    OPCODE_CASE(SET_OPCODE_LOCAL) {
       DECODE_C();
       SET_LOCAL(y, LOCAL(value));
-      continue;
+      NEXT();
     }
-    case SET_OPCODE_UNSIGNED : {
+    OPCODE_CASE(SET_OPCODE_UNSIGNED) {
       DECODE_C();
       SET_LOCAL(y, (uint64_t)value);
-      continue;
+      NEXT();
     }
-    case SET_OPCODE_SIGNED : {
+    OPCODE_CASE(SET_OPCODE_SIGNED) {
       DECODE_C();
       SET_LOCAL(y, (int64_t)(int32_t)value);
-      continue;
+      NEXT();
     }
-    case SET_OPCODE_CODE : {
+    OPCODE_CASE(SET_OPCODE_CODE) {
       DECODE_C();
       SET_LOCAL(y, value);
-      continue;
+      NEXT();
     }
-    case SET_OPCODE_GLOBAL : {
+    OPCODE_CASE(SET_OPCODE_GLOBAL) {
       DECODE_C();
       char* address = global_mem + global_offsets[value];
       SET_LOCAL(y, (uint64_t)address);
-      continue;
+      NEXT();
     }
-    case SET_OPCODE_DATA : {
+    OPCODE_CASE(SET_OPCODE_DATA) {
       DECODE_C();
       char* address = data_mem + 8 * data_offsets[value];
       SET_LOCAL(y, (uint64_t)address);
-      continue;
+      NEXT();
     }
-    case SET_OPCODE_CONST : {
+    OPCODE_CASE(SET_OPCODE_CONST) {
       DECODE_C();
       SET_LOCAL(y, const_table[value]);
-      continue;
+      NEXT();
     }
-    case SET_OPCODE_WIDE : {
+    OPCODE_CASE(SET_OPCODE_WIDE) {
       DECODE_D();
       SET_LOCAL(x, value);
-      continue;
+      NEXT();
     }
-    case SET_REG_OPCODE_LOCAL : {
+    OPCODE_CASE(SET_REG_OPCODE_LOCAL) {
       DECODE_C();
       SET_REG(y, LOCAL(value));
-      continue;
+      NEXT();
     }
-    case SET_REG_OPCODE_UNSIGNED : {
+    OPCODE_CASE(SET_REG_OPCODE_UNSIGNED) {
       DECODE_C();
       SET_REG(y, (uint64_t)value);
-      continue;
+      NEXT();
     }
-    case SET_REG_OPCODE_SIGNED : {
+    OPCODE_CASE(SET_REG_OPCODE_SIGNED) {
       DECODE_C();
       SET_REG(y, (int64_t)(int32_t)value);
-      continue;
+      NEXT();
     }
-    case SET_REG_OPCODE_CODE : {
+    OPCODE_CASE(SET_REG_OPCODE_CODE) {
       DECODE_C();
       SET_REG(y, value);
-      continue;
+      NEXT();
     }
-    case SET_REG_OPCODE_GLOBAL : {
+    OPCODE_CASE(SET_REG_OPCODE_GLOBAL) {
       DECODE_C();
       char* address = global_mem + global_offsets[value];
       SET_REG(y, (uint64_t)address);
-      continue;
+      NEXT();
     }
-    case SET_REG_OPCODE_DATA : {
+    OPCODE_CASE(SET_REG_OPCODE_DATA) {
       DECODE_C();
       char* address = data_mem + 8 * data_offsets[value];
       SET_REG(y, (uint64_t)address);
-      continue;
+      NEXT();
     }
-    case SET_REG_OPCODE_CONST : {
+    OPCODE_CASE(SET_REG_OPCODE_CONST) {
       DECODE_C();
       SET_REG(y, const_table[value]);
-      continue;
+      NEXT();
     }
-    case SET_REG_OPCODE_WIDE : {
+    OPCODE_CASE(SET_REG_OPCODE_WIDE) {
       DECODE_D();
       SET_REG(x, value);
-      continue;
+      NEXT();
     }
-    case GET_REG_OPCODE : {
+    OPCODE_CASE(GET_REG_OPCODE) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, registers[value]);
-      continue;
+      NEXT();
     }
-    case CALL_OPCODE_LOCAL : {
+    OPCODE_CASE(CALL_OPCODE_LOCAL) {
       DECODE_C();
       int num_locals = y;
       uint64_t fid = LOCAL(value);
-      uint64_t fpos = code_offsets[fid];
+      uint64_t fpos = FUNCTION_OFFSET(fid);
       PUSH_FRAME(num_locals);
       pc = instructions + fpos;
-      continue;
+      NEXT();
     }
-    case CALL_OPCODE_CODE : {
+    OPCODE_CASE(CALL_OPCODE_CODE) {
       DECODE_C();
       int num_locals = y;
       uint64_t fid = value;
-      uint64_t fpos = code_offsets[fid];
+      uint64_t fpos = FUNCTION_OFFSET(fid);
       PUSH_FRAME(num_locals);
       pc = instructions + fpos;
-      continue;
+      NEXT();
     }
-    case CALL_CLOSURE_OPCODE : {
+    OPCODE_CASE(CALL_CLOSURE_OPCODE) {
       DECODE_C();
       int num_locals = y;
       Function* clo = (Function*)(LOCAL(value) - REF_TAG_BITS + 8);
       uint64_t fid = clo->code;
-      uint64_t fpos = code_offsets[fid];
+      uint64_t fpos = FUNCTION_OFFSET(fid);
       PUSH_FRAME(num_locals);
       pc = instructions + fpos;
-      continue;
+      NEXT();
     }
-    case TCALL_OPCODE_LOCAL : {
+    OPCODE_CASE(TCALL_OPCODE_LOCAL) {
       DECODE_C();
       int num_locals = y;
       uint64_t fid = LOCAL(value);
-      uint64_t fpos = code_offsets[fid];
+      uint64_t fpos = FUNCTION_OFFSET(fid);
       pc = instructions + fpos;
-      continue;
+      NEXT();
     }
-    case TCALL_OPCODE_CODE : {
+    OPCODE_CASE(TCALL_OPCODE_CODE) {
       DECODE_C();
       int num_locals = y;
       uint64_t fid = value;
-      uint64_t fpos = code_offsets[fid];
+      uint64_t fpos = FUNCTION_OFFSET(fid);
       pc = instructions + fpos;
-      continue;
+      NEXT();
     }
-    case TCALL_CLOSURE_OPCODE : {
+    OPCODE_CASE(TCALL_CLOSURE_OPCODE) {
       DECODE_A_UNSIGNED();
       Function* clo = (Function*)(LOCAL(value) - REF_TAG_BITS + 8);
       uint64_t fid = clo->code;
-      uint64_t fpos = code_offsets[fid];
+      uint64_t fpos = FUNCTION_OFFSET(fid);
       pc = instructions + fpos;
-      continue;
+      NEXT();
     }
-    case CALLC_OPCODE_LOCAL : {
+    OPCODE_CASE(CALLC_OPCODE_LOCAL) {
       DECODE_C();
       void* faddr = (void*)LOCAL(value);
       int num_locals = y;
@@ -1029,9 +1653,9 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
       RESTORE_STATE();
       pc = instructions + stack_pointer->returnpc;
       POP_FRAME(num_locals);
-      continue;
+      NEXT();
     }
-    case CALLC_OPCODE_WIDE : {
+    OPCODE_CASE(CALLC_OPCODE_WIDE) {
       DECODE_D();
       void* faddr = (void*)(uint64_t)value;
       int num_locals = x;
@@ -1041,20 +1665,20 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
       RESTORE_STATE();
       pc = instructions + stack_pointer->returnpc;
       POP_FRAME(num_locals);
-      continue;
+      NEXT();
     }
-    case POP_FRAME_OPCODE : {
+    OPCODE_CASE(POP_FRAME_OPCODE) {
       DECODE_A_UNSIGNED();
       int num_locals = value;
       POP_FRAME(num_locals);
-      continue;
+      NEXT();
     }
-    case LIVE_OPCODE : {
+    OPCODE_CASE(LIVE_OPCODE) {
       DECODE_A_UNSIGNED();
       stack_pointer->liveness_map = value;
-      continue;
+      NEXT();
     }
-    case ENTER_STACK_OPCODE : {
+    OPCODE_CASE(ENTER_STACK_OPCODE) {
       DECODE_A_UNSIGNED();
       //Save current stack
       stk->stack_pointer = stack_pointer;
@@ -1066,11 +1690,11 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
       stack_limit = (char*)(stk->frames) + stk->size;
       //Load starting address
       uint64_t fid = stk->pc;
-      uint64_t stk_pc = code_offsets[fid];
+      uint64_t stk_pc = FUNCTION_OFFSET(fid);
       pc = instructions + stk_pc;
-      continue;
+      NEXT();
     }
-    case YIELD_OPCODE : {
+    OPCODE_CASE(YIELD_OPCODE) {
       DECODE_A_UNSIGNED();
       //Save current stack
       stk->stack_pointer = stack_pointer;
@@ -1081,9 +1705,9 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
       stack_pointer = stk->stack_pointer;
       stack_limit = (char*)(stk->frames) + stk->size;
       pc = instructions + stk->pc;
-      continue;
+      NEXT();
     }
-    case RETURN_OPCODE : {
+    OPCODE_CASE(RETURN_OPCODE) {
       DECODE_A_UNSIGNED();
       int64_t retpc = stack_pointer->returnpc;
       if(retpc == SYSTEM_RETURN_STUB){
@@ -1104,7 +1728,7 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
         retpc = stk->pc;
 
         pc = instructions + retpc;
-        continue;
+        NEXT();
       }
       else if(retpc < 0){
         //Save registers
@@ -1115,10 +1739,10 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
       }
       else{
         pc = instructions + retpc;
-        continue;
+        NEXT();
       }
     }
-    case DUMP_OPCODE : {
+    OPCODE_CASE(DUMP_OPCODE) {
       DECODE_A_UNSIGNED();
       int64_t xl = (int64_t)LOCAL(value);
       char xb = (char)xl;
@@ -1127,574 +1751,594 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
       float xd = LOCAL_DOUBLE(value);
       printf("DUMP LOCAL %d: (byte = %d, int = %d, long = %" PRId64 ", ptr = %p, float = %f, double = %f)\n",
              value, xb, xi, xl, (void*)xl, xf, xd);
-      continue;
+      NEXT();
     }
-    case INT_ADD_OPCODE : {
+    OPCODE_CASE(INT_ADD_OPCODE) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) + (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case INT_SUB_OPCODE : {
+    OPCODE_CASE(INT_SUB_OPCODE) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) - (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case INT_MUL_OPCODE : {
+    OPCODE_CASE(INT_MUL_OPCODE) {
       DECODE_C();
       SET_LOCAL(x, ((int64_t)(LOCAL(y)) >> 32LL) * (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case INT_DIV_OPCODE : {
+    OPCODE_CASE(INT_DIV_OPCODE) {
       DECODE_C();
       int64_t sy = (int64_t)LOCAL(y);
       int64_t sz = (int64_t)LOCAL(value);
       SET_LOCAL(x, (sy / sz) << 32LL);
-      continue;
+      NEXT();
     }
-    case INT_MOD_OPCODE : {
+    OPCODE_CASE(INT_MOD_OPCODE) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) % (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case INT_AND_OPCODE : {
+    OPCODE_CASE(INT_AND_OPCODE) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) & (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case INT_OR_OPCODE : {
+    OPCODE_CASE(INT_OR_OPCODE) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) | (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case INT_XOR_OPCODE : {
+    OPCODE_CASE(INT_XOR_OPCODE) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) ^ (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case INT_SHL_OPCODE : {
+    OPCODE_CASE(INT_SHL_OPCODE) {
       DECODE_C();
       int64_t sy = (int64_t)LOCAL(y);
       int64_t sz = (int64_t)LOCAL(value);
       SET_LOCAL(x, sy << (sz >> 32LL));
-      continue;
+      NEXT();
     }
-    case INT_SHR_OPCODE : {
+    OPCODE_CASE(INT_SHR_OPCODE) {
       DECODE_C();
       uint64_t uy = LOCAL(y);
       int64_t sz = (int64_t)LOCAL(value);
       uint64_t r = uy >> (sz >> 32LL);
       SET_LOCAL(x, (r >> 32LL) << 32LL);
-      continue;
+      NEXT();
     }
-    case INT_ASHR_OPCODE : {
+    OPCODE_CASE(INT_ASHR_OPCODE) {
       DECODE_C();
       int64_t sy = (int64_t)LOCAL(y);
       int64_t sz = (int64_t)LOCAL(value);
       uint64_t r = sy >> (sz >> 32LL);
       SET_LOCAL(x, (r >> 32LL) << 32LL);
-      continue;
+      NEXT();
     }
-    case INT_LT_OPCODE : {
+    OPCODE_CASE(INT_LT_OPCODE) {
       DECODE_C();
       SET_LOCAL(x, BOOLREF((int64_t)(LOCAL(y)) < (int64_t)(LOCAL(value))));
-      continue;
+      NEXT();
     }
-    case INT_GT_OPCODE : {
+    OPCODE_CASE(INT_GT_OPCODE) {
       DECODE_C();
       SET_LOCAL(x, BOOLREF((int64_t)(LOCAL(y)) > (int64_t)(LOCAL(value))));
-      continue;
+      NEXT();
     }
-    case INT_LE_OPCODE : {
+    OPCODE_CASE(INT_LE_OPCODE) {
       DECODE_C();
       SET_LOCAL(x, BOOLREF((int64_t)(LOCAL(y)) <= (int64_t)(LOCAL(value))));
-      continue;
+      NEXT();
     }
-    case INT_GE_OPCODE : {
+    OPCODE_CASE(INT_GE_OPCODE) {
       DECODE_C();
       SET_LOCAL(x, BOOLREF((int64_t)(LOCAL(y)) >= (int64_t)(LOCAL(value))));
-      continue;
+      NEXT();
     }
-    case REF_EQ_OPCODE : {
+    OPCODE_CASE(REF_EQ_OPCODE) {
       DECODE_C();
       SET_LOCAL(x, BOOLREF(LOCAL(y) == LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case EQ_OPCODE_REF : {
+    OPCODE_CASE(EQ_OPCODE_REF) {
       DECODE_C();
       SET_LOCAL(x, LOCAL(y) == LOCAL(value));
-      continue;
+      NEXT();
     }
-    case EQ_OPCODE_BYTE : {
+    OPCODE_CASE(EQ_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (uint8_t)LOCAL(y) == (uint8_t)LOCAL(value));
-      continue;
+      NEXT();
     }
-    case EQ_OPCODE_INT : {
+    OPCODE_CASE(EQ_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)LOCAL(y) == (int32_t)LOCAL(value));
-      continue;
+      NEXT();
     }
-    case EQ_OPCODE_LONG : {
+    OPCODE_CASE(EQ_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)LOCAL(y) == (int64_t)LOCAL(value));
-      continue;
+      NEXT();
     }
-    case EQ_OPCODE_FLOAT : {
+    OPCODE_CASE(EQ_OPCODE_FLOAT) {
       DECODE_C();
       SET_LOCAL(x, LOCAL_FLOAT(y) == LOCAL_FLOAT(value));
-      continue;
+      NEXT();
     }
-    case EQ_OPCODE_DOUBLE : {
+    OPCODE_CASE(EQ_OPCODE_DOUBLE) {
       DECODE_C();
       SET_LOCAL(x, LOCAL_DOUBLE(y) == LOCAL_DOUBLE(value));
-      continue;
+      NEXT();
     }
-    case REF_NE_OPCODE : {
+    OPCODE_CASE(REF_NE_OPCODE) {
       DECODE_C();
       SET_LOCAL(x, BOOLREF(LOCAL(y) != LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case NE_OPCODE_REF : {
+    OPCODE_CASE(NE_OPCODE_REF) {
       DECODE_C();
       SET_LOCAL(x, LOCAL(y) != LOCAL(value));
-      continue;
+      NEXT();
     }
-    case NE_OPCODE_BYTE : {
+    OPCODE_CASE(NE_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (uint8_t)LOCAL(y) != (uint8_t)LOCAL(value));
-      continue;
+      NEXT();
     }
-    case NE_OPCODE_INT : {
+    OPCODE_CASE(NE_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)LOCAL(y) != (int32_t)LOCAL(value));
-      continue;
+      NEXT();
     }
-    case NE_OPCODE_LONG : {
+    OPCODE_CASE(NE_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)LOCAL(y) != (int64_t)LOCAL(value));
-      continue;
+      NEXT();
     }
-    case NE_OPCODE_FLOAT : {
+    OPCODE_CASE(NE_OPCODE_FLOAT) {
       DECODE_C();
       SET_LOCAL(x, LOCAL_FLOAT(y) != LOCAL_FLOAT(value));
-      continue;
+      NEXT();
     }
-    case NE_OPCODE_DOUBLE : {
+    OPCODE_CASE(NE_OPCODE_DOUBLE) {
       DECODE_C();
       SET_LOCAL(x, LOCAL_DOUBLE(y) != LOCAL_DOUBLE(value));
-      continue;
+      NEXT();
     }
-    case ADD_OPCODE_BYTE : {
+    OPCODE_CASE(ADD_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (char)(LOCAL(y)) + (char)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case ADD_OPCODE_INT : {
+    OPCODE_CASE(ADD_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)(LOCAL(y)) + (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case ADD_OPCODE_LONG : {
+    OPCODE_CASE(ADD_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) + (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case ADD_OPCODE_FLOAT : {
+    OPCODE_CASE(ADD_IMM_OPCODE_INT) {
+      DECODE_C();
+      SET_LOCAL(x, (int32_t)(LOCAL(y)) + (int32_t)value);
+      NEXT();
+    }
+    OPCODE_CASE(ADD_IMM_OPCODE_LONG) {
+      DECODE_C();
+      SET_LOCAL(x, (int64_t)(LOCAL(y)) + (int64_t)(int32_t)value);
+      NEXT();
+    }
+    OPCODE_CASE(ADD_OPCODE_FLOAT) {
       DECODE_C();
       SET_LOCAL_FLOAT(x, LOCAL_FLOAT(y) + LOCAL_FLOAT(value));
-      continue;
+      NEXT();
     }
-    case ADD_OPCODE_DOUBLE : {
+    OPCODE_CASE(ADD_OPCODE_DOUBLE) {
       DECODE_C();
       SET_LOCAL_DOUBLE(x, LOCAL_DOUBLE(y) + LOCAL_DOUBLE(value));
-      continue;
+      NEXT();
     }
-    case SUB_OPCODE_BYTE : {
+    OPCODE_CASE(SUB_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (char)(LOCAL(y)) - (char)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case SUB_OPCODE_INT : {
+    OPCODE_CASE(SUB_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)(LOCAL(y)) - (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case SUB_OPCODE_LONG : {
+    OPCODE_CASE(SUB_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) - (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
+    }
+    OPCODE_CASE(SUB_IMM_OPCODE_INT) {
+      DECODE_C();
+      SET_LOCAL(x, (int32_t)(LOCAL(y)) - (int32_t)value);
+      NEXT();
     }
-    case SUB_OPCODE_FLOAT : {
+    OPCODE_CASE(SUB_IMM_OPCODE_LONG) {
+      DECODE_C();
+      SET_LOCAL(x, (int64_t)(LOCAL(y)) - (int64_t)(int32_t)value);
+      NEXT();
+    }
+    OPCODE_CASE(SUB_OPCODE_FLOAT) {
       DECODE_C();
       SET_LOCAL_FLOAT(x, LOCAL_FLOAT(y) - LOCAL_FLOAT(value));
-      continue;
+      NEXT();
     }
-    case SUB_OPCODE_DOUBLE : {
+    OPCODE_CASE(SUB_OPCODE_DOUBLE) {
       DECODE_C();
       SET_LOCAL_DOUBLE(x, LOCAL_DOUBLE(y) - LOCAL_DOUBLE(value));
-      continue;
+      NEXT();
     }
-    case MUL_OPCODE_BYTE : {
+    OPCODE_CASE(MUL_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (char)(LOCAL(y)) * (char)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case MUL_OPCODE_INT : {
+    OPCODE_CASE(MUL_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)(LOCAL(y)) * (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case MUL_OPCODE_LONG : {
+    OPCODE_CASE(MUL_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) * (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case MUL_OPCODE_FLOAT : {
+    OPCODE_CASE(MUL_OPCODE_FLOAT) {
       DECODE_C();
       SET_LOCAL_FLOAT(x, LOCAL_FLOAT(y) * LOCAL_FLOAT(value));
-      continue;
+      NEXT();
     }
-    case MUL_OPCODE_DOUBLE : {
+    OPCODE_CASE(MUL_OPCODE_DOUBLE) {
       DECODE_C();
       SET_LOCAL_DOUBLE(x, LOCAL_DOUBLE(y) * LOCAL_DOUBLE(value));
-      continue;
+      NEXT();
     }
-    case DIV_OPCODE_BYTE : {
+    OPCODE_CASE(DIV_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (char)(LOCAL(y)) / (char)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case DIV_OPCODE_INT : {
+    OPCODE_CASE(DIV_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)(LOCAL(y)) / (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case DIV_OPCODE_LONG : {
+    OPCODE_CASE(DIV_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) / (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case DIV_OPCODE_FLOAT : {
+    OPCODE_CASE(DIV_OPCODE_FLOAT) {
       DECODE_C();
       SET_LOCAL_FLOAT(x, LOCAL_FLOAT(y) / LOCAL_FLOAT(value));
-      continue;
+      NEXT();
     }
-    case DIV_OPCODE_DOUBLE : {
+    OPCODE_CASE(DIV_OPCODE_DOUBLE) {
       DECODE_C();
       SET_LOCAL_DOUBLE(x, LOCAL_DOUBLE(y) / LOCAL_DOUBLE(value));
-      continue;
+      NEXT();
     }
-    case MOD_OPCODE_BYTE : {
+    OPCODE_CASE(MOD_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (char)(LOCAL(y)) % (char)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case MOD_OPCODE_INT : {
+    OPCODE_CASE(MOD_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)(LOCAL(y)) % (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case MOD_OPCODE_LONG : {
+    OPCODE_CASE(MOD_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) % (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case AND_OPCODE_BYTE : {
+    OPCODE_CASE(AND_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (char)(LOCAL(y)) & (char)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case AND_OPCODE_INT : {
+    OPCODE_CASE(AND_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)(LOCAL(y)) & (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case AND_OPCODE_LONG : {
+    OPCODE_CASE(AND_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) & (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case OR_OPCODE_BYTE : {
+    OPCODE_CASE(OR_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (char)(LOCAL(y)) | (char)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case OR_OPCODE_INT : {
+    OPCODE_CASE(OR_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)(LOCAL(y)) | (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case OR_OPCODE_LONG : {
+    OPCODE_CASE(OR_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) | (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case XOR_OPCODE_BYTE : {
+    OPCODE_CASE(XOR_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (char)(LOCAL(y)) ^ (char)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case XOR_OPCODE_INT : {
+    OPCODE_CASE(XOR_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)(LOCAL(y)) ^ (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case XOR_OPCODE_LONG : {
+    OPCODE_CASE(XOR_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) ^ (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case SHL_OPCODE_BYTE : {
+    OPCODE_CASE(SHL_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (char)(LOCAL(y)) << (char)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case SHL_OPCODE_INT : {
+    OPCODE_CASE(SHL_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)(LOCAL(y)) << (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case SHL_OPCODE_LONG : {
+    OPCODE_CASE(SHL_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) << (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case SHR_OPCODE_BYTE : {
+    OPCODE_CASE(SHR_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (unsigned char)(LOCAL(y)) >> (unsigned char)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case SHR_OPCODE_INT : {
+    OPCODE_CASE(SHR_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (uint32_t)(LOCAL(y)) >> (uint32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case SHR_OPCODE_LONG : {
+    OPCODE_CASE(SHR_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (uint64_t)(LOCAL(y)) >> (uint64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case ASHR_OPCODE_INT : {
+    OPCODE_CASE(ASHR_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)(LOCAL(y)) >> (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case ASHR_OPCODE_LONG : {
+    OPCODE_CASE(ASHR_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) >> (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case LT_OPCODE_INT : {
+    OPCODE_CASE(LT_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)(LOCAL(y)) < (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case LT_OPCODE_LONG : {
+    OPCODE_CASE(LT_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) < (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case LT_OPCODE_FLOAT : {
+    OPCODE_CASE(LT_OPCODE_FLOAT) {
       DECODE_C();
       SET_LOCAL(x, LOCAL_FLOAT(y) < LOCAL_FLOAT(value));
-      continue;
+      NEXT();
     }
-    case LT_OPCODE_DOUBLE : {
+    OPCODE_CASE(LT_OPCODE_DOUBLE) {
       DECODE_C();
       SET_LOCAL(x, LOCAL_DOUBLE(y) < LOCAL_DOUBLE(value));
-      continue;
+      NEXT();
     }
-    case GT_OPCODE_INT : {
+    OPCODE_CASE(GT_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)(LOCAL(y)) > (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case GT_OPCODE_LONG : {
+    OPCODE_CASE(GT_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) > (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case GT_OPCODE_FLOAT : {
+    OPCODE_CASE(GT_OPCODE_FLOAT) {
       DECODE_C();
       SET_LOCAL(x, LOCAL_FLOAT(y) > LOCAL_FLOAT(value));
-      continue;
+      NEXT();
     }
-    case GT_OPCODE_DOUBLE : {
+    OPCODE_CASE(GT_OPCODE_DOUBLE) {
       DECODE_C();
       SET_LOCAL(x, LOCAL_DOUBLE(y) > LOCAL_DOUBLE(value));
-      continue;
+      NEXT();
     }
-    case LE_OPCODE_INT : {
+    OPCODE_CASE(LE_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)(LOCAL(y)) <= (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case LE_OPCODE_LONG : {
+    OPCODE_CASE(LE_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) <= (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case LE_OPCODE_FLOAT : {
+    OPCODE_CASE(LE_OPCODE_FLOAT) {
       DECODE_C();
       SET_LOCAL(x, LOCAL_FLOAT(y) <= LOCAL_FLOAT(value));
-      continue;
+      NEXT();
     }
-    case LE_OPCODE_DOUBLE : {
+    OPCODE_CASE(LE_OPCODE_DOUBLE) {
       DECODE_C();
       SET_LOCAL(x, LOCAL_DOUBLE(y) <= LOCAL_DOUBLE(value));
-      continue;
+      NEXT();
     }
-    case GE_OPCODE_INT : {
+    OPCODE_CASE(GE_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (int32_t)(LOCAL(y)) >= (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case GE_OPCODE_LONG : {
+    OPCODE_CASE(GE_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (int64_t)(LOCAL(y)) >= (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case GE_OPCODE_FLOAT : {
+    OPCODE_CASE(GE_OPCODE_FLOAT) {
       DECODE_C();
       SET_LOCAL(x, LOCAL_FLOAT(y) >= LOCAL_FLOAT(value));
-      continue;
+      NEXT();
     }
-    case GE_OPCODE_DOUBLE : {
+    OPCODE_CASE(GE_OPCODE_DOUBLE) {
       DECODE_C();
       SET_LOCAL(x, LOCAL_DOUBLE(y) >= LOCAL_DOUBLE(value));
-      continue;
+      NEXT();
     }
 
-    case ULE_OPCODE_BYTE : {
+    OPCODE_CASE(ULE_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (uint8_t)(LOCAL(y)) <= (uint8_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case ULE_OPCODE_INT : {
+    OPCODE_CASE(ULE_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (uint32_t)(LOCAL(y)) <= (uint32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case ULE_OPCODE_LONG : {
+    OPCODE_CASE(ULE_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (uint64_t)(LOCAL(y)) <= (uint64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case ULT_OPCODE_BYTE : {
+    OPCODE_CASE(ULT_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (uint8_t)(LOCAL(y)) < (uint8_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case ULT_OPCODE_INT : {
+    OPCODE_CASE(ULT_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (uint32_t)(LOCAL(y)) < (uint32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case ULT_OPCODE_LONG : {
+    OPCODE_CASE(ULT_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (uint64_t)(LOCAL(y)) < (uint64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case UGT_OPCODE_BYTE : {
+    OPCODE_CASE(UGT_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (uint8_t)(LOCAL(y)) > (uint8_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case UGT_OPCODE_INT : {
+    OPCODE_CASE(UGT_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (uint32_t)(LOCAL(y)) > (uint32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case UGT_OPCODE_LONG : {
+    OPCODE_CASE(UGT_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (uint64_t)(LOCAL(y)) > (uint64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case UGE_OPCODE_BYTE : {
+    OPCODE_CASE(UGE_OPCODE_BYTE) {
       DECODE_C();
       SET_LOCAL(x, (uint8_t)(LOCAL(y)) >= (uint8_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case UGE_OPCODE_INT : {
+    OPCODE_CASE(UGE_OPCODE_INT) {
       DECODE_C();
       SET_LOCAL(x, (uint32_t)(LOCAL(y)) >= (uint32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case UGE_OPCODE_LONG : {
+    OPCODE_CASE(UGE_OPCODE_LONG) {
       DECODE_C();
       SET_LOCAL(x, (uint64_t)(LOCAL(y)) >= (uint64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case INT_NOT_OPCODE : {
+    OPCODE_CASE(INT_NOT_OPCODE) {
       DECODE_B_UNSIGNED();
       uint64_t y = LOCAL(value);
       SET_LOCAL(x, ((~ y) >> 32LL) << 32LL);
-      continue;
+      NEXT();
     }
-    case INT_NEG_OPCODE : {
+    OPCODE_CASE(INT_NEG_OPCODE) {
       DECODE_B_UNSIGNED();
       int64_t y = LOCAL(value);
       SET_LOCAL(x, - y);
-      continue;
+      NEXT();
     }
-    case NOT_OPCODE_BYTE : {
+    OPCODE_CASE(NOT_OPCODE_BYTE) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, ~ ((uint8_t)LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case NOT_OPCODE_INT : {
+    OPCODE_CASE(NOT_OPCODE_INT) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, ~ ((uint32_t)LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case NOT_OPCODE_LONG : {
+    OPCODE_CASE(NOT_OPCODE_LONG) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, ~ ((uint64_t)LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case NEG_OPCODE_INT : {
+    OPCODE_CASE(NEG_OPCODE_INT) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, - ((int32_t)LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case NEG_OPCODE_LONG : {
+    OPCODE_CASE(NEG_OPCODE_LONG) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, - ((int64_t)LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case NEG_OPCODE_FLOAT : {
+    OPCODE_CASE(NEG_OPCODE_FLOAT) {
       DECODE_B_UNSIGNED();
       SET_LOCAL_FLOAT(x, - LOCAL_FLOAT(value));
-      continue;
+      NEXT();
     }
-    case NEG_OPCODE_DOUBLE : {
+    OPCODE_CASE(NEG_OPCODE_DOUBLE) {
       DECODE_B_UNSIGNED();
       SET_LOCAL_DOUBLE(x, - LOCAL_DOUBLE(value));
-      continue;
+      NEXT();
     }
-    case DEREF_OPCODE : {
+    OPCODE_CASE(DEREF_OPCODE) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, LOCAL(value) + 8 - REF_TAG_BITS);
-      continue;
+      NEXT();
     }
-    case TYPEOF_OPCODE : {
+    OPCODE_CASE(TYPEOF_OPCODE) {
       DECODE_C();
       int format = value;
-      int index = read_dispatch_table(vms, format);
+      int index = cached_read_dispatch_table(vms, pc0, format);
       SET_LOCAL(x, index);
-      continue;
+      NEXT();
     }
-    case JUMP_SET_OPCODE : {
+    OPCODE_CASE(JUMP_SET_OPCODE) {
       DECODE_F();
       F_JUMP(LOCAL(x));
     }
-    case JUMP_TAGBITS_OPCODE : {
+    OPCODE_CASE(JUMP_TAGBITS_OPCODE) {
       DECODE_F();
       int tagbits = (int)(LOCAL(x)) & 0x7;
       int bits = y;
       F_JUMP(tagbits == bits);
     }
-    case JUMP_TAGWORD_OPCODE : {
+    OPCODE_CASE(JUMP_TAGWORD_OPCODE) {
       DECODE_F();
       uint64_t obj = LOCAL(x);
       int tagbits = (int)obj & 0x7;
@@ -1704,221 +2348,221 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
         F_JUMP(*p == tag);
       }else{
         pc = pc0 + (n2 * 4);
-        continue;
+        NEXT();
       }
     }
-    case GOTO_OPCODE : {
+    OPCODE_CASE(GOTO_OPCODE) {
       DECODE_A_SIGNED();
       pc = pc0 + (value * 4);
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_BYTE_FLOAT : {
+    OPCODE_CASE(CONV_OPCODE_BYTE_FLOAT) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, (uint8_t)(LOCAL_FLOAT(value)));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_BYTE_DOUBLE : {
+    OPCODE_CASE(CONV_OPCODE_BYTE_DOUBLE) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, (uint8_t)(LOCAL_DOUBLE(value)));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_INT_BYTE : {
+    OPCODE_CASE(CONV_OPCODE_INT_BYTE) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, (int32_t)(uint8_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_INT_FLOAT : {
+    OPCODE_CASE(CONV_OPCODE_INT_FLOAT) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, (int32_t)(LOCAL_FLOAT(value)));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_INT_DOUBLE : {
+    OPCODE_CASE(CONV_OPCODE_INT_DOUBLE) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, (int32_t)(LOCAL_DOUBLE(value)));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_LONG_BYTE : {
+    OPCODE_CASE(CONV_OPCODE_LONG_BYTE) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, (int64_t)(uint8_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_LONG_INT : {
+    OPCODE_CASE(CONV_OPCODE_LONG_INT) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, (int64_t)(int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_LONG_FLOAT : {
+    OPCODE_CASE(CONV_OPCODE_LONG_FLOAT) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, (int64_t)(LOCAL_FLOAT(value)));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_LONG_DOUBLE : {
+    OPCODE_CASE(CONV_OPCODE_LONG_DOUBLE) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, (int64_t)(LOCAL_DOUBLE(value)));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_FLOAT_BYTE : {
+    OPCODE_CASE(CONV_OPCODE_FLOAT_BYTE) {
       DECODE_B_UNSIGNED();
       SET_LOCAL_FLOAT(x, (uint8_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_FLOAT_INT : {
+    OPCODE_CASE(CONV_OPCODE_FLOAT_INT) {
       DECODE_B_UNSIGNED();
       SET_LOCAL_FLOAT(x, (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_FLOAT_LONG : {
+    OPCODE_CASE(CONV_OPCODE_FLOAT_LONG) {
       DECODE_B_UNSIGNED();
       SET_LOCAL_FLOAT(x, (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_FLOAT_DOUBLE : {
+    OPCODE_CASE(CONV_OPCODE_FLOAT_DOUBLE) {
       DECODE_B_UNSIGNED();
       SET_LOCAL_FLOAT(x, LOCAL_DOUBLE(value));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_DOUBLE_BYTE : {
+    OPCODE_CASE(CONV_OPCODE_DOUBLE_BYTE) {
       DECODE_B_UNSIGNED();
       SET_LOCAL_DOUBLE(x, (uint8_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_DOUBLE_INT : {
+    OPCODE_CASE(CONV_OPCODE_DOUBLE_INT) {
       DECODE_B_UNSIGNED();
       SET_LOCAL_DOUBLE(x, (int32_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_DOUBLE_LONG : {
+    OPCODE_CASE(CONV_OPCODE_DOUBLE_LONG) {
       DECODE_B_UNSIGNED();
       SET_LOCAL_DOUBLE(x, (int64_t)(LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case CONV_OPCODE_DOUBLE_FLOAT : {
+    OPCODE_CASE(CONV_OPCODE_DOUBLE_FLOAT) {
       DECODE_B_UNSIGNED();
       SET_LOCAL_DOUBLE(x, LOCAL_FLOAT(value));
-      continue;
+      NEXT();
     }
-    case DETAG_OPCODE : {
+    OPCODE_CASE(DETAG_OPCODE) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, LOCAL(value) >> 32LL);
-      continue;
+      NEXT();
     }
-    case TAG_OPCODE_BYTE : {
+    OPCODE_CASE(TAG_OPCODE_BYTE) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, ((uint64_t)(uint8_t)(LOCAL(value)) << 32LL) + BYTE_TAG_BITS);
-      continue;
+      NEXT();
     }
-    case TAG_OPCODE_CHAR : {
+    OPCODE_CASE(TAG_OPCODE_CHAR) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, ((uint64_t)(uint8_t)(LOCAL(value)) << 32LL) + CHAR_TAG_BITS);
-      continue;
+      NEXT();
     }
-    case TAG_OPCODE_INT : {
+    OPCODE_CASE(TAG_OPCODE_INT) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, ((uint64_t)LOCAL(value) << 32LL) + INT_TAG_BITS);
-      continue;
+      NEXT();
     }
-    case TAG_OPCODE_FLOAT : {
+    OPCODE_CASE(TAG_OPCODE_FLOAT) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, ((uint64_t)LOCAL(value) << 32LL) + FLOAT_TAG_BITS);
-      continue;
+      NEXT();
     }
-    case STORE_OPCODE_1 : {
+    OPCODE_CASE(STORE_OPCODE_1) {
       DECODE_E();
       char* address = (char*)(LOCAL(x) + value);
       char storeval = (char)(LOCAL(z));
       *address = storeval;
-      continue;
+      NEXT();
     }
-    case STORE_OPCODE_4 : {
+    OPCODE_CASE(STORE_OPCODE_4) {
       DECODE_E();
       int32_t* address = (int32_t*)(LOCAL(x) + value);
       int32_t storeval = (int32_t)(LOCAL(z));
       *address = storeval;
-      continue;
+      NEXT();
     }
-    case STORE_OPCODE_8 : {
+    OPCODE_CASE(STORE_OPCODE_8) {
       DECODE_E();
       int64_t* address = (int64_t*)(LOCAL(x) + value);
       int64_t storeval = (int64_t)(LOCAL(z));
       *address = storeval;
-      continue;
+      NEXT();
     }
-    case STORE_OPCODE_1_VAR_OFFSET : {
+    OPCODE_CASE(STORE_OPCODE_1_VAR_OFFSET) {
       DECODE_E();
       char* address = (char*)(LOCAL(x) + LOCAL(y) + value);
       char storeval = (char)(LOCAL(z));
       *address = storeval;
-      continue;
+      NEXT();
     }
-    case STORE_OPCODE_4_VAR_OFFSET : {
+    OPCODE_CASE(STORE_OPCODE_4_VAR_OFFSET) {
       DECODE_E();
       int32_t* address = (int32_t*)(LOCAL(x) + LOCAL(y) + value);
       int32_t storeval = (int32_t)(LOCAL(z));
       *address = storeval;
-      continue;
+      NEXT();
     }
-    case STORE_OPCODE_8_VAR_OFFSET : {
+    OPCODE_CASE(STORE_OPCODE_8_VAR_OFFSET) {
       DECODE_E();
       int64_t* address = (int64_t*)(LOCAL(x) + LOCAL(y) + value);
       int64_t storeval = (int64_t)(LOCAL(z));
       *address = storeval;
-      continue;
+      NEXT();
     }
-    case STORE_WITH_BARRIER_OPCODE : {
+    OPCODE_CASE(STORE_WITH_BARRIER_OPCODE) {
       DECODE_E();
 
       //Retrieve address to store to and value to store.
       uint64_t* address = (uint64_t*)(LOCAL(x) + value);
       uint64_t val = (uint64_t)(LOCAL(z));
       barriered_store(vms, address, val);
-      continue;
+      NEXT();
     }
-    case STORE_WITH_BARRIER_OPCODE_VAR_OFFSET : {
+    OPCODE_CASE(STORE_WITH_BARRIER_OPCODE_VAR_OFFSET) {
       DECODE_E();
 
       //Retrieve address to store to and value to store.
       uint64_t* address = (uint64_t*)(LOCAL(x) + LOCAL(y) + value);
       uint64_t val = (uint64_t)(LOCAL(z));
       barriered_store(vms, address, val);
-      continue;
+      NEXT();
     }
-    case LOAD_OPCODE_1 : {
+    OPCODE_CASE(LOAD_OPCODE_1) {
       DECODE_E();
       char* address = (char*)(LOCAL(y) + value);
       SET_LOCAL(x, *address);
-      continue;
+      NEXT();
     }
-    case LOAD_OPCODE_4 : {
+    OPCODE_CASE(LOAD_OPCODE_4) {
       DECODE_E();
       int32_t* address = (int32_t*)(LOCAL(y) + value);
       SET_LOCAL(x, *address);
-      continue;
+      NEXT();
     }
-    case LOAD_OPCODE_8 : {
+    OPCODE_CASE(LOAD_OPCODE_8) {
       DECODE_E();
       int64_t* address = (int64_t*)(LOCAL(y) + value);
       SET_LOCAL(x, *address);
-      continue;
+      NEXT();
     }
-    case LOAD_OPCODE_1_VAR_OFFSET : {
+    OPCODE_CASE(LOAD_OPCODE_1_VAR_OFFSET) {
       DECODE_E();
       char* address = (char*)(LOCAL(y) + LOCAL(z) + value);
       SET_LOCAL(x, *address);
-      continue;
+      NEXT();
     }
-    case LOAD_OPCODE_4_VAR_OFFSET : {
+    OPCODE_CASE(LOAD_OPCODE_4_VAR_OFFSET) {
       DECODE_E();
       int32_t* address = (int32_t*)(LOCAL(y) + LOCAL(z) + value);
       SET_LOCAL(x, *address);
-      continue;
+      NEXT();
     }
-    case LOAD_OPCODE_8_VAR_OFFSET : {
+    OPCODE_CASE(LOAD_OPCODE_8_VAR_OFFSET) {
       DECODE_E();
       int64_t* address = (int64_t*)(LOCAL(y) + LOCAL(z) + value);
       SET_LOCAL(x, *address);
-      continue;
+      NEXT();
     }
-    case RESERVE_OPCODE_LOCAL : {
+    OPCODE_CASE(RESERVE_OPCODE_LOCAL) {
       DECODE_C();
       uint64_t size = 8 + LOCAL(value);
       size = (size + 7) & -8;
@@ -1926,36 +2570,36 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
       int offset = x * 4;
       if(heap_top + size <= heap_limit){
         pc = pc0 + offset;
-        continue;
+        NEXT();
       }else{
         SET_REG(0, BOOLREF(0));
         SET_REG(1, 1ULL);
         SET_REG(2, size);
-        uint64_t fpos = code_offsets[EXTEND_HEAP_FN];
+        uint64_t fpos = FUNCTION_OFFSET(EXTEND_HEAP_FN);
         PUSH_FRAME(num_locals);
         pc = instructions + fpos;
-        continue;
+        NEXT();
       }
     }
-    case RESERVE_OPCODE_CONST : {
+    OPCODE_CASE(RESERVE_OPCODE_CONST) {
       DECODE_C();
       uint64_t size = value;
       int num_locals = y;
       int offset = x * 4;
       if(heap_top + size <= heap_limit){
         pc = pc0 + offset;
-        continue;
+        NEXT();
       }else{
         SET_REG(0, BOOLREF(0));
         SET_REG(1, 1ULL);
         SET_REG(2, size);
-        uint64_t fpos = code_offsets[EXTEND_HEAP_FN];
+        uint64_t fpos = FUNCTION_OFFSET(EXTEND_HEAP_FN);
         PUSH_FRAME(num_locals);
         pc = instructions + fpos;
-        continue;
+        NEXT();
       }
     }
-    case ALLOC_OPCODE_CONST : {
+    OPCODE_CASE(ALLOC_OPCODE_CONST) {
       DECODE_C();
       int num_bytes = 8 + y;
       int type = value;
@@ -1963,9 +2607,9 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
       uint64_t obj = ptr_to_ref(heap_top);
       SET_LOCAL(x, obj);
       heap_top = heap_top + num_bytes;
-      continue;
+      NEXT();
     }
-    case ALLOC_OPCODE_LOCAL : {
+    OPCODE_CASE(ALLOC_OPCODE_LOCAL) {
       DECODE_C();
       uint64_t num_bytes = 8 + LOCAL(y);
       num_bytes = (num_bytes + 7) & -8;
@@ -1974,9 +2618,9 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
       uint64_t obj = ptr_to_ref(heap_top);
       SET_LOCAL(x, obj);
       heap_top = heap_top + num_bytes;
-      continue;
+      NEXT();
     }
-    case GC_OPCODE : {
+    OPCODE_CASE(GC_OPCODE) {
       DECODE_B_UNSIGNED();
       //Size to extend
       uint64_t size = LOCAL(value);
@@ -1986,237 +2630,237 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
       RESTORE_STATE();
       //Return heap remaining
       SET_LOCAL(x, remaining);
-      continue;
+      NEXT();
     }
-    case PRINT_STACK_TRACE_OPCODE : {
+    OPCODE_CASE(PRINT_STACK_TRACE_OPCODE) {
       DECODE_B_UNSIGNED();
       uint64_t stack = LOCAL(value);
       call_print_stack_trace(vms, stack);
       SET_LOCAL(x, 0);
-      continue;
+      NEXT();
     }
-    case COLLECT_STACK_TRACE_OPCODE : {
+    OPCODE_CASE(COLLECT_STACK_TRACE_OPCODE) {
       DECODE_B_UNSIGNED();
       uint64_t stack = LOCAL(value);
       void* packed_trace = call_collect_stack_trace(vms, stack);
       SET_LOCAL(x, (uint64_t)packed_trace);
-      continue;
+      NEXT();
     }
-    case FLUSH_VM_OPCODE : {
+    OPCODE_CASE(FLUSH_VM_OPCODE) {
       DECODE_A_UNSIGNED();
       SAVE_STATE();
       SET_LOCAL(value, (uint64_t)vms);
-      continue;
+      NEXT();
     }
-    case C_RSP_OPCODE : {
+    OPCODE_CASE(C_RSP_OPCODE) {
       DECODE_A_UNSIGNED();
       SET_LOCAL(value, stanza_crsp);
-      continue;
+      NEXT();
     }
-    case JUMP_INT_LT_OPCODE : {
+    OPCODE_CASE(JUMP_INT_LT_OPCODE) {
       DECODE_F();
       F_JUMP((int64_t)LOCAL(x) < (int64_t)LOCAL(y));
     }
-    case JUMP_INT_GT_OPCODE : {
+    OPCODE_CASE(JUMP_INT_GT_OPCODE) {
       DECODE_F();
       F_JUMP((int64_t)LOCAL(x) > (int64_t)LOCAL(y));
     }
-    case JUMP_INT_LE_OPCODE : {
+    OPCODE_CASE(JUMP_INT_LE_OPCODE) {
       DECODE_F();
       F_JUMP((int64_t)LOCAL(x) <= (int64_t)LOCAL(y));
     }
-    case JUMP_INT_GE_OPCODE : {
+    OPCODE_CASE(JUMP_INT_GE_OPCODE) {
       DECODE_F();
       F_JUMP((int64_t)LOCAL(x) >= (int64_t)LOCAL(y));
     }
-    case JUMP_EQ_OPCODE_REF : {
+    OPCODE_CASE(JUMP_EQ_OPCODE_REF) {
       DECODE_F();
       F_JUMP(LOCAL(x) == LOCAL(y));
     }
-    case JUMP_EQ_OPCODE_BYTE : {
+    OPCODE_CASE(JUMP_EQ_OPCODE_BYTE) {
       DECODE_F();
       F_JUMP((int8_t)LOCAL(x) == (int8_t)LOCAL(y));
     }
-    case JUMP_EQ_OPCODE_INT : {
+    OPCODE_CASE(JUMP_EQ_OPCODE_INT) {
       DECODE_F();
       F_JUMP((int32_t)LOCAL(x) == (int32_t)LOCAL(y));
     }
-    case JUMP_EQ_OPCODE_LONG : {
+    OPCODE_CASE(JUMP_EQ_OPCODE_LONG) {
       DECODE_F();
       F_JUMP((int64_t)LOCAL(x) == (int64_t)LOCAL(y));
     }
-    case JUMP_EQ_OPCODE_FLOAT : {
+    OPCODE_CASE(JUMP_EQ_OPCODE_FLOAT) {
       DECODE_F();
       F_JUMP(LOCAL_FLOAT(x) == LOCAL_FLOAT(y));
     }
-    case JUMP_EQ_OPCODE_DOUBLE : {
+    OPCODE_CASE(JUMP_EQ_OPCODE_DOUBLE) {
       DECODE_F();
       F_JUMP(LOCAL_DOUBLE(x) == LOCAL_DOUBLE(y));
     }
-    case JUMP_NE_OPCODE_REF : {
+    OPCODE_CASE(JUMP_NE_OPCODE_REF) {
       DECODE_F();
       F_JUMP(LOCAL(x) != LOCAL(y));
     }
-    case JUMP_NE_OPCODE_BYTE : {
+    OPCODE_CASE(JUMP_NE_OPCODE_BYTE) {
       DECODE_F();
       F_JUMP((int8_t)LOCAL(x) != (int8_t)LOCAL(y));
     }
-    case JUMP_NE_OPCODE_INT : {
+    OPCODE_CASE(JUMP_NE_OPCODE_INT) {
       DECODE_F();
       F_JUMP((int32_t)LOCAL(x) != (int32_t)LOCAL(y));
     }
-    case JUMP_NE_OPCODE_LONG : {
+    OPCODE_CASE(JUMP_NE_OPCODE_LONG) {
       DECODE_F();
       F_JUMP((int64_t)LOCAL(x) != (int64_t)LOCAL(y));
     }
-    case JUMP_NE_OPCODE_FLOAT : {
+    OPCODE_CASE(JUMP_NE_OPCODE_FLOAT) {
       DECODE_F();
       F_JUMP(LOCAL_FLOAT(x) != LOCAL_FLOAT(y));
     }
-    case JUMP_NE_OPCODE_DOUBLE : {
+    OPCODE_CASE(JUMP_NE_OPCODE_DOUBLE) {
       DECODE_F();
       F_JUMP(LOCAL_DOUBLE(x) != LOCAL_DOUBLE(y));
     }
-    case JUMP_LT_OPCODE_INT : {
+    OPCODE_CASE(JUMP_LT_OPCODE_INT) {
       DECODE_F();
       F_JUMP((int32_t)LOCAL(x) < (int32_t)LOCAL(y));
     }
-    case JUMP_LT_OPCODE_LONG : {
+    OPCODE_CASE(JUMP_LT_OPCODE_LONG) {
       DECODE_F();
       F_JUMP((int64_t)LOCAL(x) < (int64_t)LOCAL(y));
     }
-    case JUMP_LT_OPCODE_FLOAT : {
+    OPCODE_CASE(JUMP_LT_OPCODE_FLOAT) {
       DECODE_F();
       F_JUMP(LOCAL_FLOAT(x) < LOCAL_FLOAT(y));
     }
-    case JUMP_LT_OPCODE_DOUBLE : {
+    OPCODE_CASE(JUMP_LT_OPCODE_DOUBLE) {
       DECODE_F();
       F_JUMP(LOCAL_DOUBLE(x) < LOCAL_DOUBLE(y));
     }
-    case JUMP_GT_OPCODE_INT : {
+    OPCODE_CASE(JUMP_GT_OPCODE_INT) {
       DECODE_F();
       F_JUMP((int32_t)LOCAL(x) > (int32_t)LOCAL(y));
     }
-    case JUMP_GT_OPCODE_LONG : {
+    OPCODE_CASE(JUMP_GT_OPCODE_LONG) {
       DECODE_F();
       F_JUMP((int64_t)LOCAL(x) > (int64_t)LOCAL(y));
     }
-    case JUMP_GT_OPCODE_FLOAT : {
+    OPCODE_CASE(JUMP_GT_OPCODE_FLOAT) {
       DECODE_F();
       F_JUMP(LOCAL_FLOAT(x) > LOCAL_FLOAT(y));
     }
-    case JUMP_GT_OPCODE_DOUBLE : {
+    OPCODE_CASE(JUMP_GT_OPCODE_DOUBLE) {
       DECODE_F();
       F_JUMP(LOCAL_DOUBLE(x) > LOCAL_DOUBLE(y));
     }
-    case JUMP_LE_OPCODE_INT : {
+    OPCODE_CASE(JUMP_LE_OPCODE_INT) {
       DECODE_F();
       F_JUMP((int32_t)LOCAL(x) <= (int32_t)LOCAL(y));
     }
-    case JUMP_LE_OPCODE_LONG : {
+    OPCODE_CASE(JUMP_LE_OPCODE_LONG) {
       DECODE_F();
       F_JUMP((int64_t)LOCAL(x) <= (int64_t)LOCAL(y));
     }
-    case JUMP_LE_OPCODE_FLOAT : {
+    OPCODE_CASE(JUMP_LE_OPCODE_FLOAT) {
       DECODE_F();
       F_JUMP(LOCAL_FLOAT(x) <= LOCAL_FLOAT(y));
     }
-    case JUMP_LE_OPCODE_DOUBLE : {
+    OPCODE_CASE(JUMP_LE_OPCODE_DOUBLE) {
       DECODE_F();
       F_JUMP(LOCAL_DOUBLE(x) <= LOCAL_DOUBLE(y));
     }
-    case JUMP_GE_OPCODE_INT : {
+    OPCODE_CASE(JUMP_GE_OPCODE_INT) {
       DECODE_F();
       F_JUMP((int32_t)LOCAL(x) >= (int32_t)LOCAL(y));
     }
-    case JUMP_GE_OPCODE_LONG : {
+    OPCODE_CASE(JUMP_GE_OPCODE_LONG) {
       DECODE_F();
       F_JUMP((int64_t)LOCAL(x) >= (int64_t)LOCAL(y));
     }
-    case JUMP_GE_OPCODE_FLOAT : {
+    OPCODE_CASE(JUMP_GE_OPCODE_FLOAT) {
       DECODE_F();
       F_JUMP(LOCAL_FLOAT(x) >= LOCAL_FLOAT(y));
     }
-    case JUMP_GE_OPCODE_DOUBLE : {
+    OPCODE_CASE(JUMP_GE_OPCODE_DOUBLE) {
       DECODE_F();
       F_JUMP(LOCAL_DOUBLE(x) >= LOCAL_DOUBLE(y));
     }
-    case JUMP_ULE_OPCODE_BYTE : {
+    OPCODE_CASE(JUMP_ULE_OPCODE_BYTE) {
       DECODE_F();
       F_JUMP((uint8_t)LOCAL(x) <= (uint8_t)LOCAL(y));
     }
-    case JUMP_ULE_OPCODE_INT : {
+    OPCODE_CASE(JUMP_ULE_OPCODE_INT) {
       DECODE_F();
       F_JUMP((uint32_t)LOCAL(x) <= (uint32_t)LOCAL(y));
     }
-    case JUMP_ULE_OPCODE_LONG : {
+    OPCODE_CASE(JUMP_ULE_OPCODE_LONG) {
       DECODE_F();
       F_JUMP((uint64_t)LOCAL(x) <= (uint64_t)LOCAL(y));
     }
-    case JUMP_ULT_OPCODE_BYTE : {
+    OPCODE_CASE(JUMP_ULT_OPCODE_BYTE) {
       DECODE_F();
       F_JUMP((uint8_t)LOCAL(x) < (uint8_t)LOCAL(y));
     }
-    case JUMP_ULT_OPCODE_INT : {
+    OPCODE_CASE(JUMP_ULT_OPCODE_INT) {
       DECODE_F();
       F_JUMP((uint32_t)LOCAL(x) < (uint32_t)LOCAL(y));
     }
-    case JUMP_ULT_OPCODE_LONG : {
+    OPCODE_CASE(JUMP_ULT_OPCODE_LONG) {
       DECODE_F();
       F_JUMP((uint64_t)LOCAL(x) < (uint64_t)LOCAL(y));
     }
-    case JUMP_UGE_OPCODE_BYTE : {
+    OPCODE_CASE(JUMP_UGE_OPCODE_BYTE) {
       DECODE_F();
       F_JUMP((uint8_t)LOCAL(x) >= (uint8_t)LOCAL(y));
     }
-    case JUMP_UGE_OPCODE_INT : {
+    OPCODE_CASE(JUMP_UGE_OPCODE_INT) {
       DECODE_F();
       F_JUMP((uint32_t)LOCAL(x) >= (uint32_t)LOCAL(y));
     }
-    case JUMP_UGE_OPCODE_LONG : {
+    OPCODE_CASE(JUMP_UGE_OPCODE_LONG) {
       DECODE_F();
       F_JUMP((uint64_t)LOCAL(x) >= (uint64_t)LOCAL(y));
     }
-    case JUMP_UGT_OPCODE_BYTE : {
+    OPCODE_CASE(JUMP_UGT_OPCODE_BYTE) {
       DECODE_F();
       F_JUMP((uint8_t)LOCAL(x) > (uint8_t)LOCAL(y));
     }
-    case JUMP_UGT_OPCODE_INT : {
+    OPCODE_CASE(JUMP_UGT_OPCODE_INT) {
       DECODE_F();
       F_JUMP((uint32_t)LOCAL(x) > (uint32_t)LOCAL(y));
     }
-    case JUMP_UGT_OPCODE_LONG : {
+    OPCODE_CASE(JUMP_UGT_OPCODE_LONG) {
       DECODE_F();
       F_JUMP((uint64_t)LOCAL(x) > (uint64_t)LOCAL(y));
     }
-    case DISPATCH_OPCODE : {
+    OPCODE_CASE(DISPATCH_OPCODE) {
       DECODE_A_UNSIGNED();
       uint32_t* tgts = (uint32_t*)(pc + 4);
       //DECODE_TGTS();
       int format = value;
-      int index = read_dispatch_table(vms, format);
+      int index = cached_read_dispatch_table(vms, pc0, format);
       int tgt = tgts[index];
       pc = pc0 + (tgt * 4);
-      continue;
+      NEXT();
     }
-    case DISPATCH_METHOD_OPCODE : {
+    OPCODE_CASE(DISPATCH_METHOD_OPCODE) {
       DECODE_A_UNSIGNED();
       uint32_t* tgts = (uint32_t*)(pc + 4);
       //DECODE_TGTS();
       int format = value;
-      int index = read_dispatch_table(vms, format);
+      int index = cached_read_dispatch_table(vms, pc0, format);
       if(index < 2){
         int tgt = tgts[index];
         pc = pc0 + (tgt * 4);
-        continue;
+        NEXT();
       }else{
         int fid = index - 2;
-        uint64_t fpos = code_offsets[fid];
+        uint64_t fpos = FUNCTION_OFFSET(fid);
         pc = instructions + fpos;
-        continue;
+        NEXT();
       }
     }
-    case JUMP_REG_OPCODE : {
+    OPCODE_CASE(JUMP_REG_OPCODE) {
       DECODE_C();
       int reg = x;
       uint64_t arity = y;
@@ -2224,9 +2868,9 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
       if(registers[reg] == arity){
         pc = pc0 + offset;
       }
-      continue;
+      NEXT();
     }
-    case FNENTRY_OPCODE : {
+    OPCODE_CASE(FNENTRY_OPCODE) {
       DECODE_A_UNSIGNED();
       int frame_size = value * 8 + sizeof(StackFrame);
       int size_required = frame_size + sizeof(StackFrame);
@@ -2252,54 +2896,64 @@ void vmloop (VMState* vms, uint64_t stanza_crsp, int64_t starting_fid){
         stack_pointer = stk->frames;
         stack_pointer->returnpc = SYSTEM_RETURN_STUB;
         //Jump to stack extender
-        uint64_t fpos = code_offsets[EXTEND_STACK_FN];
+        uint64_t fpos = FUNCTION_OFFSET(EXTEND_STACK_FN);
         pc = instructions + fpos;
       }
-      continue;
+      NEXT();
     }
-    case LOWEST_ZERO_BIT_COUNT_OPCODE_LONG : {
+    OPCODE_CASE(LOWEST_ZERO_BIT_COUNT_OPCODE_LONG) {
       DECODE_B_UNSIGNED();
       SET_LOCAL(x, lowest_zero_bit_count((uint64_t)LOCAL(value)));
-      continue;
+      NEXT();
     }
-    case SET_BIT_OPCODE : {
+    OPCODE_CASE(SET_BIT_OPCODE) {
       DECODE_C();
       uint64_t bit_index = (uint64_t)LOCAL(y);
       uint64_t* bitset_base = (uint64_t*)LOCAL(value);
       set_bit(bit_index, bitset_base);
-      continue;
+      NEXT();
     }
-    case CLEAR_BIT_OPCODE : {
+    OPCODE_CASE(CLEAR_BIT_OPCODE) {
       DECODE_C();
       uint64_t bit_index = (uint64_t)LOCAL(y);
       uint64_t* bitset_base = (uint64_t*)LOCAL(value);
       clear_bit(bit_index, bitset_base);
-      continue;
+      NEXT();
     }
-    case TEST_BIT_OPCODE : {
+    OPCODE_CASE(TEST_BIT_OPCODE) {
       DECODE_C();
       uint64_t bit_index = (uint64_t)LOCAL(y);
       uint64_t* bitset_base = (uint64_t*)LOCAL(value);
       SET_LOCAL(x, test_bit(bit_index, bitset_base));
-      continue;
+      NEXT();
     }
-    case TEST_AND_SET_BIT_OPCODE : {
+    OPCODE_CASE(TEST_AND_SET_BIT_OPCODE) {
       DECODE_C();
       uint64_t bit_index = (uint64_t)LOCAL(y);
       uint64_t* bitset_base = (uint64_t*)LOCAL(value);
       SET_LOCAL(x, test_and_set_bit(bit_index, bitset_base));
-      continue;
+      NEXT();
     }
-    case TEST_AND_CLEAR_BIT_OPCODE : {
+    OPCODE_CASE(TEST_AND_CLEAR_BIT_OPCODE) {
       DECODE_C();
       uint64_t bit_index = (uint64_t)LOCAL(y);
       uint64_t* bitset_base = (uint64_t*)LOCAL(value);
       SET_LOCAL(x, test_and_clear_bit(bit_index, bitset_base));
-      continue;
+      NEXT();
     }
     }
 
+    #ifdef CVM_THREADED_DISPATCH
+    //Record the instruction, then execute it.
+    PROFILE_HANDLER:
+    profile_instruction(vms, pc0, opcode);
+    goto *dispatch_table[opcode];
+    #endif
+
     //Done
+    #ifdef CVM_THREADED_DISPATCH
+    INVALID_OPCODE_HANDLER:
+    #endif
     printf("Invalid opcode: %d\n", opcode);
     exit(-1);
   }
@@ -2385,9 +3039,8 @@ int dhash (int d, int x, int n){
   return ((int)a & 0x7FFFFFFF) % n;
 }
 
-int lookup_trie_table (VMState* vms, TrieTable* trie_table){
+int lookup_trie_table_with_type (TrieTable* trie_table, int type){
   int n = trie_table->n;
-  int type = argtype(vms, trie_table->index);
   if(n <= 4){
     return lookup_small_etable(small_etable(trie_table), type, n);
   }else{
@@ -2403,6 +3056,11 @@ int lookup_trie_table (VMState* vms, TrieTable* trie_table){
   }
 }
 
+int lookup_trie_table (VMState* vms, TrieTable* trie_table){
+  int type = argtype(vms, trie_table->index);
+  return lookup_trie_table_with_type(trie_table, type);
+}
+
 int read_dispatch_table (VMState* vms, int format){
   int* trie_table = vms->trie_table[format];
   int table_offset = 0;
@@ -2412,3 +3070,89 @@ int read_dispatch_table (VMState* vms, int format){
     table_offset = value;
   }
 }
+
+//============================================================
+//==================== Inline Caches =========================
+//============================================================
+
+//Each dispatch site (DISPATCH_OPCODE, DISPATCH_METHOD_OPCODE and
+//TYPEOF_OPCODE) caches the results of its most recent trie walks,
+//keyed by the address of the instruction. The walk through the trie
+//tables is determined entirely by the types of the arguments it
+//examines, so an entry records the (register, type) pair tested at
+//each level of the walk, and is a hit if every register still holds
+//an argument of the recorded type.
+//
+//The cache is direct-mapped on the site address, with two entries per
+//site so that bimorphic sites do not thrash. An entry is also keyed by
+//the format it walked and by the code_epoch of the VMState. Loading
+//code and lazily encoding a function both advance the code_epoch, and
+//either may move the instruction buffer or rewrite the trie tables, so
+//entries recorded before the change are never hit after it, even if
+//a different site now lives at the same address.
+
+#define DISPATCH_CACHE_SETS 1024
+#define DISPATCH_CACHE_WAYS 2
+#define DISPATCH_CACHE_DEPTH 4
+
+typedef struct {
+  char* site;
+  uint64_t epoch;
+  int format;
+  int depth;
+  int result;
+  int indices[DISPATCH_CACHE_DEPTH];
+  int types[DISPATCH_CACHE_DEPTH];
+} DispatchCacheEntry;
+
+DispatchCacheEntry dispatch_cache[DISPATCH_CACHE_SETS][DISPATCH_CACHE_WAYS];
+
+static inline int dispatch_cache_hit (VMState* vms, DispatchCacheEntry* e, char* site, int format){
+  if(e->site != site || e->format != format || e->epoch != vms->code_epoch) return 0;
+  for(int i=0; i<e->depth; i++)
+    if(argtype(vms, e->indices[i]) != e->types[i]) return 0;
+  return 1;
+}
+
+int cached_read_dispatch_table (VMState* vms, char* site, int format){
+  DispatchCacheEntry* set = dispatch_cache[((uint64_t)site >> 2) & (DISPATCH_CACHE_SETS - 1)];
+
+  //Check the cached entries for this site.
+  for(int i=0; i<DISPATCH_CACHE_WAYS; i++)
+    if(dispatch_cache_hit(vms, &set[i], site, format)) return set[i].result;
+
+  //Miss: walk the trie tables, recording the types examined.
+  DispatchCacheEntry e;
+  int* trie_table = vms->trie_table[format];
+  int table_offset = 0;
+  int depth = 0;
+  int result;
+  while(1){
+    TrieTable* t = (TrieTable*)(trie_table + table_offset);
+    int type = argtype(vms, t->index);
+    if(depth < DISPATCH_CACHE_DEPTH){
+      e.indices[depth] = t->index;
+      e.types[depth] = type;
+    }
+    depth++;
+    int value = lookup_trie_table_with_type(t, type);
+    if(value < 0){
+      result = -value - 1;
+      break;
+    }
+    table_offset = value;
+  }
+
+  //Walks that are too deep to record are not cached.
+  if(depth <= DISPATCH_CACHE_DEPTH){
+    e.site = site;
+    e.epoch = vms->code_epoch;
+    e.format = format;
+    e.depth = depth;
+    e.result = result;
+    for(int i=DISPATCH_CACHE_WAYS - 1; i>0; i--)
+      set[i] = set[i - 1];
+    set[0] = e;
+  }
+  return result;
+}
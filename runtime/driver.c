@@ -9,6 +9,7 @@
 #else
   #include<sys/wait.h>
   #include<sys/mman.h>
+  #include<sys/file.h>
 #endif
 #include<stdint.h>
 #include<stdbool.h>
@@ -376,6 +377,113 @@ stz_long file_time_modified (const stz_byte* filename){
   return 0;
 }
 
+//             File Signature
+//             ==============
+
+//Writes the size, modification time (seconds and nanoseconds), and
+//inode of the given file into sig[0..3]. Used to detect whether a file
+//has changed without reading its contents.
+//Returns -1 if the file cannot be stat'ed.
+stz_int file_signature (const stz_byte* filename, stz_long* sig){
+  struct stat attrib;
+  if(stat(C_CSTR(filename), &attrib) != 0)
+    return -1;
+  sig[0] = (stz_long)attrib.st_size;
+  sig[1] = (stz_long)attrib.st_mtime;
+#if defined(PLATFORM_LINUX)
+  sig[2] = (stz_long)attrib.st_mtim.tv_nsec;
+#elif defined(PLATFORM_OS_X)
+  sig[2] = (stz_long)attrib.st_mtimespec.tv_nsec;
+#else
+  sig[2] = 0;
+#endif
+  sig[3] = (stz_long)attrib.st_ino;
+  return 0;
+}
+
+//             Replace File
+//             ============
+
+//Renames src to dst, replacing dst if it exists. On Windows, rename
+//fails when dst exists, so MoveFileEx is used instead.
+//Returns -1 on failure.
+stz_int stz_replace_file (const stz_byte* src, const stz_byte* dst){
+#if defined(PLATFORM_WINDOWS)
+  if(!MoveFileExA(C_CSTR(src), C_CSTR(dst), MOVEFILE_REPLACE_EXISTING))
+    return -1;
+  return 0;
+#else
+  return rename(C_CSTR(src), C_CSTR(dst));
+#endif
+}
+
+//             File Locks
+//             ==========
+
+//Opens the given lock file, creating it if needed, and blocks until
+//an exclusive advisory lock is held on it. The lock is released by
+//stz_unlock_file, or by the system if the process exits.
+//Returns the handle of the locked file, or -1 on failure.
+stz_long stz_lock_file (const stz_byte* filename){
+#if defined(PLATFORM_WINDOWS)
+  HANDLE h = CreateFileA(C_CSTR(filename), GENERIC_READ | GENERIC_WRITE,
+                         FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                         OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if(h == INVALID_HANDLE_VALUE)
+    return -1;
+  OVERLAPPED overlapped;
+  memset(&overlapped, 0, sizeof(overlapped));
+  if(!LockFileEx(h, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped)){
+    CloseHandle(h);
+    return -1;
+  }
+  return (stz_long)h;
+#else
+  int fd = open(C_CSTR(filename), O_RDWR | O_CREAT, 0666);
+  if(fd < 0)
+    return -1;
+  int r;
+  do {
+    r = flock(fd, LOCK_EX);
+  } while(r != 0 && errno == EINTR);
+  if(r != 0){
+    int err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+  }
+  return (stz_long)fd;
+#endif
+}
+
+//Releases a lock acquired by stz_lock_file, and closes its file.
+//Returns -1 on failure.
+stz_int stz_unlock_file (stz_long handle){
+#if defined(PLATFORM_WINDOWS)
+  HANDLE h = (HANDLE)handle;
+  OVERLAPPED overlapped;
+  memset(&overlapped, 0, sizeof(overlapped));
+  BOOL unlocked = UnlockFileEx(h, 0, 1, 0, &overlapped);
+  BOOL closed = CloseHandle(h);
+  return (unlocked && closed) ? 0 : -1;
+#else
+  int unlocked = flock((int)handle, LOCK_UN);
+  int closed = close((int)handle);
+  return (unlocked == 0 && closed == 0) ? 0 : -1;
+#endif
+}
+
+//             Process Id
+//             ==========
+
+stz_int current_process_id (){
+#if defined(PLATFORM_WINDOWS)
+  return (stz_int)GetCurrentProcessId();
+#else
+  return (stz_int)getpid();
+#endif
+}
+
 //============================================================
 //===================== String List ==========================
 //============================================================
@@ -592,6 +700,40 @@ void stz_memory_resize (void* p, stz_long old_size, stz_long new_size) {
 
 #endif
 
+//============================================================
+//================= Read-Only File Mapping ===================
+//============================================================
+
+//Maps the contents of the given file into memory for reading.
+//On success, returns the start of the mapping and writes its length
+//into length. Returns NULL if the file cannot be mapped (including
+//when it is empty, or when mapping is not supported on the platform),
+//in which case the caller is expected to read the file instead.
+void* stz_map_file (const stz_byte* filename, stz_long* length) {
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OS_X)
+  int fd = open(C_CSTR(filename), O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat attrib;
+  void* p = NULL;
+  if (fstat(fd, &attrib) == 0 && attrib.st_size > 0) {
+    p = mmap(NULL, (size_t)attrib.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) p = NULL;
+    else *length = (stz_long)attrib.st_size;
+  }
+  close(fd);
+  return p;
+#else
+  return NULL;
+#endif
+}
+
+//Unmaps a region returned by stz_map_file.
+void stz_unmap_file (void* p, stz_long length) {
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OS_X)
+  if (p) munmap(p, (size_t)length);
+#endif
+}
+
 //============================================================
 //================= Process Runtime ==========================
 //============================================================
@@ -685,7 +827,7 @@ STANZA_API_FUNC int MAIN_FUNC (int argc, char* argv[]) {
   init.heap_size = min_heap_size;
 
   //Setup the nursery
-  const stz_long nursery_fraction = 8; // Must match the value in core.stanza
+  const stz_long nursery_fraction = 8; // Must match the initial value of nursery-fraction in core.stanza
   const stz_long nursery_size = ROUND_UP_TO_WHOLE_LONGS(min_heap_size / nursery_fraction / 2);
   init.heap_old_objects_end = init.heap_start;
   init.heap_top = init.heap_old_objects_end + nursery_size;
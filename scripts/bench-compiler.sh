@@ -0,0 +1,96 @@
+#!/bin/bash
+# Runs the compiler benchmark workloads with the given Stanza compiler,
+# and compares the time spent in each compiler pass against a baseline.
+#
+# Usage: scripts/bench-compiler.sh STANZA RESULTS-DIR [BASELINE-DIR]
+#
+# The workloads are:
+#   compile-unoptimized : compiling core and the compiler.
+#   compile-optimized   : compiling core and the compiler with -optimize.
+#   repl-load           : loading the compiler packages into the REPL.
+#   runtime             : the defbench programs in benchmarks/runtime.
+#
+# Each compiler workload is run with -timing-log, and the logs are
+# summarized into RESULTS-DIR/<workload>.tsv, which lists the total
+# time spent in each timer. The runtime benchmarks are written to
+# RESULTS-DIR/runtime.tsv by the test framework.
+#
+# If BASELINE-DIR is given, it must contain the results of a previous
+# run, and the script exits with an error if any timer or runtime
+# benchmark regressed. To record a baseline, run the script without
+# BASELINE-DIR.
+#
+# Environment variables:
+#   RUNS      : The number of runs of each compiler workload. The
+#               fastest time of each timer is kept. Defaults to 3.
+#   THRESHOLD : The allowed slowdown in percent. Defaults to 10.
+#   MIN_DELTA : Slowdowns below this many milliseconds are ignored.
+#               Defaults to 50.
+
+set -e
+
+if [ $# -lt 2 ]; then
+  echo "Usage: $0 STANZA RESULTS-DIR [BASELINE-DIR]"
+  exit 1
+fi
+
+STANZA="$1"
+RESULTS="$2"
+BASELINE="$3"
+RUNS="${RUNS:-3}"
+THRESHOLD="${THRESHOLD:-10}"
+MIN_DELTA="${MIN_DELTA:-50}"
+
+WORK="$RESULTS/work"
+mkdir -p "$WORK"
+
+summarize () {
+  "$STANZA" run build-stanza.proj benchmarks/compiler/timing-summary.stanza -- summarize "$@"
+}
+
+compare () {
+  "$STANZA" run build-stanza.proj benchmarks/compiler/timing-summary.stanza -- compare "$@" "$THRESHOLD" "$MIN_DELTA"
+}
+
+# Runs the given command RUNS times with a fresh timing log each time,
+# and summarizes the logs into RESULTS/$1.tsv.
+run_workload () {
+  local NAME="$1"
+  shift
+  local LOGS=""
+  echo "== $NAME"
+  for RUN in $(seq 1 "$RUNS"); do
+    local LOG="$WORK/$NAME-$RUN.log"
+    "$@" -timing-log "$LOG"
+    LOGS="$LOGS $LOG"
+  done
+  summarize "$RESULTS/$NAME.tsv" $LOGS
+}
+
+run_workload compile-unoptimized \
+  "$STANZA" compile build-stanza.proj stz/driver -s "$WORK/stanza.s" -build-from-source
+
+run_workload compile-optimized \
+  "$STANZA" compile build-stanza.proj stz/driver -s "$WORK/stanza.s" -build-from-source -optimize
+
+run_workload repl-load \
+  "$STANZA" repl build-stanza.proj stz/compiler-main -terminal-style simple < /dev/null
+
+echo "== runtime"
+"$STANZA" compile-test benchmarks/runtime/*.stanza -o "$WORK/runtime-bench" -optimize
+RUNTIME_FLAGS="-bench-output $RESULTS/runtime.tsv -bench-threshold $THRESHOLD"
+if [ -n "$BASELINE" ]; then
+  RUNTIME_FLAGS="$RUNTIME_FLAGS -bench-baseline $BASELINE/runtime.tsv"
+fi
+
+FAILED=0
+"$WORK/runtime-bench" $RUNTIME_FLAGS || FAILED=1
+
+if [ -n "$BASELINE" ]; then
+  for NAME in compile-unoptimized compile-optimized repl-load; do
+    echo "== Comparing $NAME against baseline"
+    compare "$RESULTS/$NAME.tsv" "$BASELINE/$NAME.tsv" || FAILED=1
+  done
+fi
+
+exit $FAILED
@@ -0,0 +1,25 @@
+#!/bin/bash
+# Runs the interpreter micro-benchmarks in benchmarks/vm with
+# each of the given Stanza compilers, using 'stanza run'.
+#
+# Usage: scripts/bench-vm.sh STANZA [STANZA ...]
+#
+# To compare threaded dispatch against the switch loop, build one
+# compiler with compiler/cvm.c compiled normally, and one with
+# compiler/cvm.c compiled with -D CVM_SWITCH_DISPATCH.
+
+set -e
+
+if [ $# -eq 0 ]; then
+  echo "Usage: $0 STANZA [STANZA ...]"
+  exit 1
+fi
+
+BENCHMARKS="calls loops arrays dispatch alloc"
+
+for STANZA in "$@"; do
+  echo "== $STANZA"
+  for BENCH in $BENCHMARKS; do
+    "$STANZA" run benchmarks/vm/$BENCH.stanza
+  done
+done
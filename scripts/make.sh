@@ -67,6 +67,7 @@ PKGFILES="math \
           stz/arg-parser \
           stz/macro-plugin \
           stz/timing-log-reader \
+          stz/timing-log-summary \
           stz/dependency-analyzer"
 PKGDIR="${PLATFORM_PREFIX}pkgs"
 STANZA_S="${PLATFORM_PREFIX}stanza.s"